@@ -0,0 +1,336 @@
+// Benchmarks vars.h or vars_hashmap.h on generated files of several sizes.
+//
+//   cc -O2 -o vars_bench bench/vars_bench.c                        (vars.h)
+//   cc -O2 -DVARS_BENCH_HASHMAP -o vars_bench bench/vars_bench.c   (vars_hashmap.h)
+//
+//   ./vars_bench [keys] [sections]
+//
+// Without arguments it runs 1000, 10000 and 100000 keys in keys / 100
+// sections. Keys cycle through int, float, bool, string, vec2, vec3 and vec4.
+// Peak memory is the most the header had allocated through VARS_MALLOC at once.
+
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L // clock_gettime() under -std=c99
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <sys/utime.h>
+#else
+#include <time.h>
+#include <utime.h>
+#endif
+
+// ---------------------------------------------
+// ALLOCATION TRACKING
+// ---------------------------------------------
+
+static size_t bench_heap_current;
+static size_t bench_heap_peak;
+
+// Each block starts with its size so frees and reallocs can be counted.
+typedef union { size_t size; long double align_float; void* align_pointer; } bench_block;
+
+static void* bench_malloc(size_t size) {
+    bench_block* block = (bench_block*)malloc(sizeof(bench_block) + size);
+    if (!block) return NULL;
+    block->size = size;
+    bench_heap_current += size;
+    if (bench_heap_current > bench_heap_peak) bench_heap_peak = bench_heap_current;
+    return block + 1;
+}
+
+static void bench_free(void* ptr) {
+    if (!ptr) return;
+    bench_block* block = (bench_block*)ptr - 1;
+    bench_heap_current -= block->size;
+    free(block);
+}
+
+static void* bench_realloc(void* ptr, size_t size) {
+    if (!ptr) return bench_malloc(size);
+    bench_block* block = (bench_block*)ptr - 1;
+    size_t old_size = block->size;
+    bench_block* grown = (bench_block*)realloc(block, sizeof(bench_block) + size);
+    if (!grown) return NULL;
+    grown->size = size;
+    bench_heap_current = bench_heap_current - old_size + size;
+    if (bench_heap_current > bench_heap_peak) bench_heap_peak = bench_heap_current;
+    return grown + 1;
+}
+
+#define VARS_MALLOC(size) bench_malloc(size)
+#define VARS_REALLOC(ptr, size) bench_realloc(ptr, size)
+#define VARS_FREE(ptr) bench_free(ptr)
+#define VARS_IMPLEMENTATION
+
+#ifdef VARS_BENCH_HASHMAP
+#include "../vars_hashmap.h"
+#define BENCH_HEADER "vars_hashmap.h"
+#define BENCH_FILE(file) (&(file))
+#else
+#include "../vars.h"
+#define BENCH_HEADER "vars.h"
+#define BENCH_FILE(file) (file)
+#endif
+
+// ---------------------------------------------
+// TIMING
+// ---------------------------------------------
+
+static double bench_now(void) {
+#ifdef _WIN32
+    LARGE_INTEGER frequency, counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+#endif
+}
+
+// Results are added up here so the compiler can't drop the gets.
+static volatile double bench_sink;
+
+// ---------------------------------------------
+// FILE GENERATION
+// ---------------------------------------------
+
+#define BENCH_TYPE_COUNT 7
+static const char* bench_type_names[BENCH_TYPE_COUNT] = { "int", "float", "bool", "string", "vec2", "vec3", "vec4" };
+
+#define BENCH_KEY_SIZE 64
+#define BENCH_PATH "vars_bench.vars"
+
+// Key i lives in section i % sections and has type i % BENCH_TYPE_COUNT.
+static void bench_key(char* out, size_t index, size_t sections) {
+    snprintf(out, BENCH_KEY_SIZE, "section%zu/key%zu", index % sections, index);
+}
+
+static void bench_write_value(FILE* out, size_t index, int salt) {
+    int n = (int)index + salt;
+    switch (index % BENCH_TYPE_COUNT) {
+        case 0: fprintf(out, "%d", n); break;
+        case 1: fprintf(out, "%d.25", n); break;
+        case 2: fputs(n & 1 ? "true" : "false", out); break;
+        case 3: fprintf(out, "\"value number %d\"", n); break;
+        case 4: fprintf(out, "(%d.5 %d.5)", n, n + 1); break;
+        case 5: fprintf(out, "(%d.5 %d.5 %d.5)", n, n + 1, n + 2); break;
+        default: fprintf(out, "(%d.5 %d.5 %d.5 %d.5)", n, n + 1, n + 2, n + 3); break;
+    }
+}
+
+// Writes keys spread over sections. A different salt changes every value, so
+// the file can be rewritten for the hot reload.
+static int bench_generate(const char* path, size_t keys, size_t sections, int salt) {
+    FILE* out = fopen(path, "wb");
+    if (!out) return 0;
+    fputs("# Generated by vars_bench\n", out);
+    for (size_t section = 0; section < sections; section++) {
+        fprintf(out, "\n:/section%zu\n", section);
+        for (size_t index = section; index < keys; index += sections) {
+            fprintf(out, "key%zu ", index);
+            bench_write_value(out, index, salt);
+            fputc('\n', out);
+        }
+    }
+    return fclose(out) == 0;
+}
+
+static long bench_file_size(const char* path) {
+    FILE* in = fopen(path, "rb");
+    if (!in) return 0;
+    fseek(in, 0, SEEK_END);
+    long size = ftell(in);
+    fclose(in);
+    return size;
+}
+
+// Moves the modification time forward so vars_hot_load() sees a new file even
+// when it was written within the same second.
+static void bench_touch(const char* path, long seconds) {
+    struct utimbuf times;
+    times.actime = (time_t)seconds;
+    times.modtime = (time_t)seconds;
+    utime(path, &times);
+}
+
+// ---------------------------------------------
+// MEASUREMENTS
+// ---------------------------------------------
+
+static void bench_get(const char* key, size_t index, vars_file* file) {
+    char buffer[256];
+    char* k = (char*)key;
+    switch (index % BENCH_TYPE_COUNT) {
+        case 0: bench_sink += vars_get_int(k, BENCH_FILE(*file)); break;
+        case 1: bench_sink += vars_get_float(k, BENCH_FILE(*file)); break;
+        case 2: bench_sink += vars_get_bool(k, BENCH_FILE(*file)); break;
+        case 3: bench_sink += vars_get_string(k, BENCH_FILE(*file), buffer)[0]; break;
+        case 4: bench_sink += vars_get_vec2(k, BENCH_FILE(*file)).y; break;
+        case 5: bench_sink += vars_get_vec3(k, BENCH_FILE(*file)).z; break;
+        default: bench_sink += vars_get_vec4(k, BENCH_FILE(*file)).w; break;
+    }
+}
+
+// Cold gets touch many different keys once. vars.h scans for every get, so
+// the sample is kept smaller there.
+#ifdef VARS_BENCH_HASHMAP
+#define BENCH_COLD_SAMPLE 100000
+#define BENCH_SET_SAMPLE 100000
+#else
+#define BENCH_COLD_SAMPLE 2000
+#define BENCH_SET_SAMPLE 200
+#endif
+
+// Hot gets repeat a few keys of one type so they stay in cache.
+#define BENCH_HOT_KEYS 16
+#define BENCH_MANY_KEYS 32
+#define BENCH_HOT_TARGET 200000
+
+static int bench_run(size_t keys, size_t sections) {
+    if (keys < BENCH_TYPE_COUNT) keys = BENCH_TYPE_COUNT;
+    if (sections == 0) sections = 1;
+    if (sections > keys) sections = keys;
+
+    if (!bench_generate(BENCH_PATH, keys, sections, 0)) {
+        fprintf(stderr, "vars_bench: Failed to write %s\n", BENCH_PATH);
+        return 0;
+    }
+    bench_touch(BENCH_PATH, 1000000000L);
+    double file_mb = (double)bench_file_size(BENCH_PATH) / (1024.0 * 1024.0);
+
+    char (*names)[BENCH_KEY_SIZE] = (char (*)[BENCH_KEY_SIZE])malloc(keys * BENCH_KEY_SIZE);
+    if (!names) return 0;
+    for (size_t i = 0; i < keys; i++) bench_key(names[i], i, sections);
+
+    printf("%s, %zu keys in %zu sections, %.2f MB\n", BENCH_HEADER, keys, sections, file_mb);
+
+    bench_heap_peak = bench_heap_current;
+    size_t heap_before = bench_heap_current;
+    double start = bench_now();
+    vars_file file = vars_load(BENCH_PATH);
+    double load_time = bench_now() - start;
+    size_t heap_loaded = bench_heap_current - heap_before;
+
+    printf("  load         %10.3f ms   %8.1f MB/s\n", load_time * 1e3, file_mb / (load_time > 0 ? load_time : 1e-9));
+
+    // Cold: keys of one type spread over the whole file, each fetched once.
+    size_t per_type = keys / BENCH_TYPE_COUNT;
+    size_t cold_count = per_type < BENCH_COLD_SAMPLE / BENCH_TYPE_COUNT ? per_type : BENCH_COLD_SAMPLE / BENCH_TYPE_COUNT;
+    size_t stride = per_type / cold_count;
+    for (int type = 0; type < BENCH_TYPE_COUNT; type++) {
+        start = bench_now();
+        for (size_t c = 0; c < cold_count; c++) {
+            size_t i = (c * stride) * BENCH_TYPE_COUNT + (size_t)type;
+            bench_get(names[i], i, &file);
+        }
+        double cold = (bench_now() - start) / (double)cold_count;
+
+        // Hot: a few keys of this type over and over.
+        size_t hot[BENCH_HOT_KEYS];
+        size_t hot_count = 0;
+        for (size_t i = (size_t)type; i < keys && hot_count < BENCH_HOT_KEYS; i += BENCH_TYPE_COUNT) hot[hot_count++] = i;
+        size_t rounds = (size_t)(0.05 / (cold > 0 ? cold : 1e-9)) / hot_count + 1;
+        if (rounds * hot_count > BENCH_HOT_TARGET) rounds = BENCH_HOT_TARGET / hot_count + 1;
+        start = bench_now();
+        for (size_t round = 0; round < rounds; round++) {
+            for (size_t h = 0; h < hot_count; h++) bench_get(names[hot[h]], hot[h], &file);
+        }
+        double warm = (bench_now() - start) / (double)(rounds * hot_count);
+
+        printf("  get %-8s cold %10.1f ns   hot %10.1f ns\n", bench_type_names[type], cold * 1e9, warm * 1e9);
+    }
+
+#ifdef VARS_BENCH_HASHMAP
+    // Batches: BENCH_MANY_KEYS keys of every type spread over the file, as a
+    // system reads them at spawn, fetched one by one and with vars_get_many().
+    // The two runs read different keys so neither warms the cache for the other.
+    {
+        static const vars_get_type types_by_index[BENCH_TYPE_COUNT] = {
+            VARS_GET_INT, VARS_GET_FLOAT, VARS_GET_BOOL, VARS_GET_STRING, VARS_GET_VEC2, VARS_GET_VEC3, VARS_GET_VEC4
+        };
+        const char* batch_keys[BENCH_MANY_KEYS];
+        vars_get_type batch_types[BENCH_MANY_KEYS];
+        size_t batch_index[BENCH_MANY_KEYS];
+        vars_result results[BENCH_MANY_KEYS];
+        char buffers[BENCH_MANY_KEYS][BENCH_KEY_SIZE];
+        size_t batches = BENCH_COLD_SAMPLE / BENCH_MANY_KEYS / 2;
+        double single_time = 0.0, many_time = 0.0;
+
+        for (size_t b = 0; b < batches * 2; b++) {
+            for (size_t k = 0; k < BENCH_MANY_KEYS; k++) {
+                size_t i = ((b * BENCH_MANY_KEYS + k) * 7919) % keys;
+                batch_index[k] = i;
+                batch_keys[k] = names[i];
+                batch_types[k] = types_by_index[i % BENCH_TYPE_COUNT];
+                results[k].string = buffers[k];
+            }
+            start = bench_now();
+            if (b % 2 == 0) {
+                for (size_t k = 0; k < BENCH_MANY_KEYS; k++) bench_get(batch_keys[k], batch_index[k], &file);
+                single_time += bench_now() - start;
+            } else {
+                bench_sink += (double)vars_get_many(&file, batch_keys, batch_types, results, BENCH_MANY_KEYS);
+                many_time += bench_now() - start;
+            }
+        }
+        printf("  get %d keys  single %8.1f ns   many %10.1f ns   per key\n", BENCH_MANY_KEYS,
+            single_time / (double)(batches * BENCH_MANY_KEYS) * 1e9, many_time / (double)(batches * BENCH_MANY_KEYS) * 1e9);
+    }
+#endif
+
+    // Sets change existing int keys so the layout of the file stays the same.
+    size_t set_count = per_type < BENCH_SET_SAMPLE ? per_type : BENCH_SET_SAMPLE;
+    start = bench_now();
+    for (size_t s = 0; s < set_count; s++) {
+        size_t i = (s * 7919 % per_type) * BENCH_TYPE_COUNT;
+        vars_set_int(names[i], (int)s, &file);
+    }
+    double set_time = bench_now() - start;
+    printf("  set          %10.1f ns   %10.0f sets/s\n", set_time / (double)set_count * 1e9,
+        (double)set_count / (set_time > 0 ? set_time : 1e-9));
+
+    start = bench_now();
+    int saved = vars_save(&file);
+    double save_time = bench_now() - start;
+    printf("  save         %10.3f ms%s\n", save_time * 1e3, saved ? "" : "   (failed)");
+
+    // Rewrite every value and reload.
+    bench_generate(BENCH_PATH, keys, sections, 1);
+    bench_touch(BENCH_PATH, 1000000100L);
+    start = bench_now();
+    int reloaded = vars_hot_load(&file);
+    double reload_time = bench_now() - start;
+    printf("  hot reload   %10.3f ms%s\n", reload_time * 1e3, reloaded ? "" : "   (not reloaded)");
+
+    printf("  memory       %10.2f MB loaded, %.2f MB peak\n",
+        (double)heap_loaded / (1024.0 * 1024.0), (double)(bench_heap_peak - heap_before) / (1024.0 * 1024.0));
+
+    vars_free(file);
+    free(names);
+    remove(BENCH_PATH);
+    return 1;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1) {
+        size_t keys = (size_t)strtoull(argv[1], NULL, 10);
+        size_t sections = argc > 2 ? (size_t)strtoull(argv[2], NULL, 10) : keys / 100;
+        return bench_run(keys, sections) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    size_t sizes[] = { 1000, 10000, 100000 };
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        if (!bench_run(sizes[i], sizes[i] / 100)) return EXIT_FAILURE;
+        printf("\n");
+    }
+    return EXIT_SUCCESS;
+}
@@ -3,19 +3,54 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 
 typedef struct {
     char* filebuf;
     char* parsed_buf;
     size_t parsed_len;
     char* file_path;
-    long last_modified;
+    int64_t last_modified; // In nanoseconds, where the platform has them.
+    unsigned int generation; // Bumped whenever parsed_buf is rebuilt.
+    struct vars_batch* batch; // Sets queued by vars_begin_batch(), NULL otherwise.
+    struct vars_usage* usage; // Timings and counters for vars_get_stats().
+    struct vars_index* index; // Keys sorted for gets, built once gets have scanned a few times.
 } vars_file;
 
+// Flags for vars_load_memory()
+#define VARS_MEMORY_BORROW 0 // Only read the caller's buffer while parsing.
+#define VARS_MEMORY_OWN    1 // Take the buffer, allocated with VARS_MALLOC, and free it once parsed.
+#define VARS_MEMORY_COPY   2 // Same as VARS_MEMORY_BORROW, since parsing copies everything it keeps.
+
 typedef struct { float x, y; } vars_vec2;
 typedef struct { float x, y, z; } vars_vec3;
 typedef struct { float x, y, z, w; } vars_vec4;
 
+// A key resolved to the offset of its value in parsed_buf. Getters that take a
+// handle skip the scan over the buffer. Sets and hot reloads rebuild the
+// buffer and bump the file's generation, and the handle then finds its key
+// again on the next get. The key string is not copied and must outlive the handle.
+typedef struct {
+    const char* key;
+    size_t offset;
+    unsigned int generation;
+} vars_handle;
+
+// Filled in by vars_get_stats(). Sizes are in bytes, times in seconds.
+typedef struct {
+    size_t entries;
+    size_t sections;       // Section declarations.
+    size_t file_bytes;     // The file as read. Files from vars_load_memory() keep none.
+    size_t parsed_bytes;   // parsed_buf, which every get scans.
+    size_t key_bytes;      // Qualified keys in parsed_buf.
+    size_t value_bytes;
+    size_t index_bytes;    // The sorted keys, once gets have built them.
+    double parse_seconds;  // Building parsed_buf at load.
+    double reload_seconds; // The last vars_hot_load() that reloaded.
+    uint64_t lookups;      // Gets by key or handle. Only counted with VARS_ENABLE_STATS.
+    uint64_t misses;       // Gets that found nothing. Only counted with VARS_ENABLE_STATS.
+} vars_stats;
+
 #ifdef VARS_DO_NOT_PREFIX_TYPES
 typedef vars_vec2 vec2;
 typedef vars_vec3 vec3;
@@ -33,6 +68,7 @@ extern "C" {
 #endif
 
 VARSAPI vars_file vars_load(const char* file_path);
+VARSAPI vars_file vars_load_memory(const char* buffer, size_t len, int flags);
 VARSAPI int vars_hot_load(vars_file* file);
 VARSAPI char* vars_get_string(char* key, vars_file file, char* buffer);
 VARSAPI float vars_get_float(char* key, vars_file file);
@@ -42,6 +78,15 @@ VARSAPI vars_vec3 vars_get_vec3(char* key, vars_file file);
 VARSAPI vars_vec4 vars_get_vec4(char* key, vars_file file);
 VARSAPI int vars_get_bool(char* key, vars_file file);
 
+VARSAPI vars_handle vars_resolve(const char* key, vars_file file);
+VARSAPI char* vars_get_string_h(vars_handle* handle, vars_file file, char* buffer);
+VARSAPI float vars_get_float_h(vars_handle* handle, vars_file file);
+VARSAPI int vars_get_int_h(vars_handle* handle, vars_file file);
+VARSAPI vars_vec2 vars_get_vec2_h(vars_handle* handle, vars_file file);
+VARSAPI vars_vec3 vars_get_vec3_h(vars_handle* handle, vars_file file);
+VARSAPI vars_vec4 vars_get_vec4_h(vars_handle* handle, vars_file file);
+VARSAPI int vars_get_bool_h(vars_handle* handle, vars_file file);
+
 // New set functions
 VARSAPI int vars_set_string(char* key, const char* value, vars_file* file);
 VARSAPI int vars_set_float(char* key, float value, vars_file* file);
@@ -51,8 +96,22 @@ VARSAPI int vars_set_vec2(char* key, vars_vec2 value, vars_file* file);
 VARSAPI int vars_set_vec3(char* key, vars_vec3 value, vars_file* file);
 VARSAPI int vars_set_vec4(char* key, vars_vec4 value, vars_file* file);
 
+// Queue sets until the matching commit and apply them with one rebuild of the
+// buffer. Gets see queued values, and vars_save() writes them. Batches nest.
+VARSAPI int vars_begin_batch(vars_file* file);
+VARSAPI int vars_commit_batch(vars_file* file);
+
 // Save function
 VARSAPI int vars_save(vars_file* file);
+VARSAPI char* vars_save_to_memory(vars_file* file, size_t* out_len);
+VARSAPI void vars_free_memory(void* memory);
+VARSAPI int vars_write_file(const char* file_path, const char* data, size_t len);
+
+VARSAPI int vars_get_stats(vars_file* file, vars_stats* stats);
+
+// Sorts the keys for gets now rather than once they have scanned a few times.
+// Needed before several threads read the same file.
+VARSAPI int vars_build_index(vars_file* file);
 
 VARSAPI int vars_free(vars_file file);
 
@@ -72,6 +131,29 @@ VARSAPI int vars_free(vars_file file);
 #include <assert.h>
 #include <sys/stat.h>
 #include <limits.h>
+#include <stdint.h>
+#include <time.h>
+#include <locale.h>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// Define all three before including the implementation to route every
+// allocation through your own allocator.
+#ifndef VARS_MALLOC
+#define VARS_MALLOC(size) malloc(size)
+#define VARS_REALLOC(ptr, size) realloc(ptr, size)
+#define VARS_FREE(ptr) free(ptr)
+#endif
 
 #define IS_CAPITAL_LETTER(ch)  (((ch) >= 'A') && ((ch) <= 'Z'))
 #define IS_LOWER_CASE_LETTER(ch)  (((ch) >= 'a') && ((ch) <= 'z'))
@@ -88,14 +170,87 @@ VARSAPI int vars_free(vars_file file);
 #define IS_SLASH(ch) ((ch) == '/')
 #define ARE_CHARS_EQUAL(ch1, ch2) ((ch1) == (ch2))
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VARS_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(__AVX2__)
+#define VARS_USE_AVX2
+#include <immintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// ---------------------------------------------
+// SCANNING
+// ---------------------------------------------
+
+// Comments and strings are skipped or copied in one go: these scanners compare
+// 32 (AVX2) or 16 (SSE2) bytes at a time and turn the matches into a bitmask,
+// so the next line end or quote is one ctz away. Short tokens are still
+// walked byte by byte.
+
+static int vars__ctz(uint32_t bits) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, bits);
+    return (int)index;
+#else
+    return __builtin_ctz(bits);
+#endif
+}
+
+// Returns the first byte in [cursor, end) equal to a, b or c, or end.
+static const char* vars__scan3(const char* cursor, const char* end, char a, char b, char c) {
+#ifdef VARS_USE_AVX2
+    const __m256i wide_a = _mm256_set1_epi8(a);
+    const __m256i wide_b = _mm256_set1_epi8(b);
+    const __m256i wide_c = _mm256_set1_epi8(c);
+    while (end - cursor >= 32) {
+        __m256i block = _mm256_loadu_si256((const __m256i*)cursor);
+        __m256i hits = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(block, wide_a), _mm256_cmpeq_epi8(block, wide_b)),
+                                       _mm256_cmpeq_epi8(block, wide_c));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(hits);
+        if (mask) return cursor + vars__ctz(mask);
+        cursor += 32;
+    }
+#endif
+#ifdef VARS_USE_SSE2
+    const __m128i narrow_a = _mm_set1_epi8(a);
+    const __m128i narrow_b = _mm_set1_epi8(b);
+    const __m128i narrow_c = _mm_set1_epi8(c);
+    while (end - cursor >= 16) {
+        __m128i block = _mm_loadu_si128((const __m128i*)cursor);
+        __m128i hits = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(block, narrow_a), _mm_cmpeq_epi8(block, narrow_b)),
+                                    _mm_cmpeq_epi8(block, narrow_c));
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(hits);
+        if (mask) return cursor + vars__ctz(mask);
+        cursor += 16;
+    }
+#endif
+    while (cursor < end && *cursor != a && *cursor != b && *cursor != c) cursor++;
+    return cursor;
+}
+
+static const char* vars__find_end_of_line(const char* cursor, const char* end) {
+    return vars__scan3(cursor, end, '\n', '\r', '\r');
+}
+
 // ---------------------------------------------
 // ENTRIES 
 // ---------------------------------------------
 
+// Entries are views into parsed_buf, so saving doesn't copy every line.
 typedef struct {
-    char* section;
-    char* key;
-    char* value;
+    const char* section; // NULL for the global section
+    size_t section_len;
+    const char* key;
+    size_t key_len;
+    const char* value;
+    size_t value_len;
 } vars_entry;
 
 typedef struct {
@@ -110,99 +265,620 @@ static void vars_entry_list_init(vars_entry_list* list) {
     list->capacity = 0;
 }
 
-static void vars_entry_list_add(vars_entry_list* list, const char* section, const char* key, const char* value) {
+static int vars_entry_list_add(vars_entry_list* list, const vars_entry* entry) {
     if (list->count >= list->capacity) {
-        list->capacity = list->capacity ? list->capacity * 2 : 16;
-        list->entries = (vars_entry*)realloc(list->entries, list->capacity * sizeof(vars_entry));
+        size_t capacity = list->capacity ? list->capacity * 2 : 16;
+        vars_entry* entries = (vars_entry*)VARS_REALLOC(list->entries, capacity * sizeof(vars_entry));
+        if (!entries) return 0;
+        list->entries = entries;
+        list->capacity = capacity;
     }
-    
-    vars_entry* entry = &list->entries[list->count++];
-    entry->section = section ? strdup(section) : NULL;
-    entry->key = strdup(key);
-    entry->value = strdup(value);
+    list->entries[list->count++] = *entry;
+    return 1;
 }
 
 static void vars_entry_list_free(vars_entry_list* list) {
-    for (size_t i = 0; i < list->count; i++) {
-        free(list->entries[i].section);
-        free(list->entries[i].key);
-        free(list->entries[i].value);
-    }
-    free(list->entries);
+    VARS_FREE(list->entries);
     list->entries = NULL;
     list->count = 0;
     list->capacity = 0;
 }
 
+static int vars__compare_bytes(const char* a, size_t a_len, const char* b, size_t b_len) {
+    int cmp = memcmp(a, b, a_len < b_len ? a_len : b_len);
+    if (cmp != 0) return cmp;
+    return a_len < b_len ? -1 : a_len > b_len;
+}
+
 static int vars_entry_compare(const void* a, const void* b) {
     const vars_entry* ea = (const vars_entry*)a;
     const vars_entry* eb = (const vars_entry*)b;
     
     // Sort by section first (NULL sections come first)
-    if (!ea->section && !eb->section) return strcmp(ea->key, eb->key);
+    if (!ea->section && !eb->section) return vars__compare_bytes(ea->key, ea->key_len, eb->key, eb->key_len);
     if (!ea->section) return -1;
     if (!eb->section) return 1;
     
-    int section_cmp = strcmp(ea->section, eb->section);
+    int section_cmp = vars__compare_bytes(ea->section, ea->section_len, eb->section, eb->section_len);
     if (section_cmp != 0) return section_cmp;
     
-    return strcmp(ea->key, eb->key);
+    return vars__compare_bytes(ea->key, ea->key_len, eb->key, eb->key_len);
 }
 
 // ---------------------------------------------
-// HELPER FUNCTIONS 
+// STATISTICS
 // ---------------------------------------------
 
-static long vars__get_file_mod_time(const char* file_path) {
-    struct stat st;
-    if (stat(file_path, &st) == 0) {
-        return (long)st.st_mtime;
+// Lives on the heap so getters, which take the file by value, can count.
+// The counters cost an increment per get and are only kept with
+// VARS_ENABLE_STATS.
+typedef struct vars_usage {
+    double parse_seconds;
+    double reload_seconds;
+    size_t file_bytes;
+    uint64_t lookups;
+    uint64_t misses;
+} vars_usage;
+
+#ifdef VARS_ENABLE_STATS
+#define VARS_COUNT_LOOKUP(usage, found) do { if (usage) { (usage)->lookups++; if (!(found)) (usage)->misses++; } } while (0)
+#else
+#define VARS_COUNT_LOOKUP(usage, found) ((void)0)
+#endif
+
+// A monotonic clock in seconds. Strict C99 builds on POSIX don't declare
+// clock_gettime(), and fall back to processor time.
+static double vars__now(void) {
+#ifdef _WIN32
+    LARGE_INTEGER frequency, counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart / (double)frequency.QuadPart;
+#elif defined(CLOCK_MONOTONIC)
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+#else
+    return (double)clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+// ---------------------------------------------
+// SORTED INDEX
+// ---------------------------------------------
+
+// Gets scan parsed_buf line by line, which is fine for a small file read a
+// few times. Once VARS_INDEX_THRESHOLD gets have scanned, the offsets of the
+// entry lines are sorted by key so later gets can binary search them. That
+// costs 4 bytes per entry, against the 100 or so a hashmap slot would.
+// A set that rewrites one line or appends one shifts or inserts offsets
+// instead of sorting again. Anything else that rebuilds parsed_buf leaves the
+// index stale until the next get. The index lives on the heap, so copies of
+// the file share it. Because gets may build it, call vars_build_index() before
+// reading one file from several threads.
+
+#ifndef VARS_INDEX_THRESHOLD
+#define VARS_INDEX_THRESHOLD 8
+#endif
+
+typedef struct vars_index {
+    uint32_t* offsets; // Entry lines, sorted by key and then by position.
+    size_t count;
+    size_t capacity;
+    unsigned int generation; // The file generation the offsets were made for.
+    int built;
+    unsigned int scans; // Gets that scanned before the index was built.
+} vars_index;
+
+// Length of the key that starts a line in parsed_buf.
+static size_t vars__index_key_len(const char* line) {
+    size_t len = 0;
+    while (line[len] && !IS_WHITE_SPACE(line[len]) && !IS_END_OF_LINE(line[len])) len++;
+    return len;
+}
+
+static int vars__index_compare_key(const char* key, size_t key_len, const char* line) {
+    size_t line_len = vars__index_key_len(line);
+    int order = memcmp(key, line, key_len < line_len ? key_len : line_len);
+    if (order) return order;
+    return key_len < line_len ? -1 : key_len > line_len;
+}
+
+// First position whose key is not below key.
+static size_t vars__index_lower_bound(const vars_index* index, const char* buf, const char* key, size_t key_len) {
+    size_t low = 0, high = index->count;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (vars__index_compare_key(key, key_len, buf + index->offsets[mid]) > 0) low = mid + 1;
+        else high = mid;
     }
-    return -1;
+    return low;
 }
 
-static vars_file vars__load_and_parse_file(const char* file_path) {
-    vars_file file = { 0 };
+// Bottom-up merge sort. It is stable, so lines with the same key stay in file
+// order and a lookup finds the first one, like the scan does.
+static void vars__index_sort(uint32_t* offsets, uint32_t* scratch, size_t count, const char* buf) {
+    uint32_t* from = offsets;
+    uint32_t* to = scratch;
+    for (size_t width = 1; width < count; width *= 2) {
+        for (size_t low = 0; low < count; low += 2 * width) {
+            size_t mid = low + width < count ? low + width : count;
+            size_t high = low + 2 * width < count ? low + 2 * width : count;
+            size_t a = low, b = mid, out = low;
+            while (a < mid && b < high) {
+                const char* line = buf + from[a];
+                if (vars__index_compare_key(buf + from[b], vars__index_key_len(buf + from[b]), line) < 0) to[out++] = from[b++];
+                else to[out++] = from[a++];
+            }
+            while (a < mid) to[out++] = from[a++];
+            while (b < high) to[out++] = from[b++];
+        }
+        uint32_t* swap = from;
+        from = to;
+        to = swap;
+    }
+    if (from != offsets) memcpy(offsets, from, count * sizeof(uint32_t));
+}
 
-    FILE* handle = fopen(file_path, "rb");
-    if (!handle) {
-        fprintf(stderr, "ERROR: vars_load: Failed to open file: %s\n", file_path);
-        exit(EXIT_FAILURE);
+// Whether a line can be found by key: a scan only matches keys that are
+// followed by whitespace, and never section declarations.
+static int vars__index_line_is_entry(const char* line) {
+    if (line[0] == ':' && line[1] == '/') return 0;
+    size_t len = vars__index_key_len(line);
+    return len > 0 && IS_WHITE_SPACE(line[len]);
+}
+
+static int vars__index_build(vars_index* index, vars_file file) {
+    index->built = 0;
+    if (file.parsed_len > UINT32_MAX) return 0;
+
+    size_t count = 0;
+    for (const char* p = file.parsed_buf; *p;) {
+        count += vars__index_line_is_entry(p);
+        while (*p && !IS_END_OF_LINE(*p)) p++;
+        if (*p) p++;
     }
 
-    fseek(handle, 0, SEEK_END);
-    long file_size = ftell(handle);
-    rewind(handle);
+    if (count > index->capacity) {
+        uint32_t* grown = (uint32_t*)VARS_REALLOC(index->offsets, count * sizeof(uint32_t));
+        if (!grown) return 0;
+        index->offsets = grown;
+        index->capacity = count;
+    }
+    uint32_t* scratch = (uint32_t*)VARS_MALLOC((count ? count : 1) * sizeof(uint32_t));
+    if (!scratch) return 0;
 
-    if (file_size <= 0) {
-        fprintf(stderr, "ERROR: vars_load: Invalid file size.\n");
-        fclose(handle);
-        exit(EXIT_FAILURE);
+    size_t filled = 0;
+    for (const char* p = file.parsed_buf; *p;) {
+        if (vars__index_line_is_entry(p)) index->offsets[filled++] = (uint32_t)(p - file.parsed_buf);
+        while (*p && !IS_END_OF_LINE(*p)) p++;
+        if (*p) p++;
     }
+    vars__index_sort(index->offsets, scratch, count, file.parsed_buf);
+    VARS_FREE(scratch);
 
-    file.filebuf = (char*)malloc(file_size);
-    file.parsed_buf = (char*)malloc(file_size * 2); // Extra space for subfolder prefixes
-    if (!file.filebuf || !file.parsed_buf) {
-        fprintf(stderr, "ERROR: vars_load: Memory allocation failed.\n");
-        fclose(handle);
-        exit(EXIT_FAILURE);
+    index->count = count;
+    index->generation = file.generation;
+    index->built = 1;
+    return 1;
+}
+
+// Whether the index is up to date for file, building it once enough gets
+// have scanned.
+static int vars__index_ready(vars_file file) {
+    vars_index* index = file.index;
+    if (!index || !file.parsed_buf) return 0;
+    if (index->built && index->generation == file.generation) return 1;
+    if (index->scans < VARS_INDEX_THRESHOLD) {
+        index->scans++;
+        return 0;
     }
+    return vars__index_build(index, file);
+}
 
-    size_t read = fread(file.filebuf, 1, file_size, handle);
-    fclose(handle);
+static char* vars__index_find(vars_file file, const char* key, size_t key_len) {
+    const vars_index* index = file.index;
+    size_t position = vars__index_lower_bound(index, file.parsed_buf, key, key_len);
+    if (position == index->count) return NULL;
+    char* p = file.parsed_buf + index->offsets[position];
+    if (vars__index_compare_key(key, key_len, p) != 0) return NULL;
+    p += key_len;
+    while (IS_WHITE_SPACE(*p)) p++;
+    return p;
+}
 
-    if (read != (size_t)file_size) {
-        fprintf(stderr, "ERROR: vars_load: File read incomplete (%zu of %ld bytes).\n", read, file_size);
-        free(file.filebuf);
-        free(file.parsed_buf);
+// Called by a set once the file has its new parsed_buf. The set either
+// rewrote the line at old_start from old_len to new_len bytes, or appended a
+// line when old_start is SIZE_MAX. Returns 0 when the index has to be rebuilt.
+static int vars__index_patch(vars_index* index, vars_file* file, size_t old_start, size_t old_len, size_t new_len) {
+    if (file->parsed_len > UINT32_MAX) return 0;
+
+    if (old_start != SIZE_MAX) {
+        // Keys don't change, so the order holds and only later lines move.
+        // Unsigned wraparound gives the right offset when the line shrank.
+        for (size_t i = 0; i < index->count; i++) {
+            if (index->offsets[i] > old_start) index->offsets[i] = index->offsets[i] + (uint32_t)new_len - (uint32_t)old_len;
+        }
+        return 1;
+    }
+
+    // The appended line is the last one in the buffer.
+    const char* last = file->parsed_buf + file->parsed_len;
+    if (last > file->parsed_buf) last--; // Its newline
+    while (last > file->parsed_buf && !IS_END_OF_LINE(last[-1])) last--;
+    if (!vars__index_line_is_entry(last)) return 1;
+
+    if (index->count == index->capacity) {
+        size_t capacity = index->capacity ? index->capacity * 2 : 16;
+        uint32_t* grown = (uint32_t*)VARS_REALLOC(index->offsets, capacity * sizeof(uint32_t));
+        if (!grown) return 0;
+        index->offsets = grown;
+        index->capacity = capacity;
+    }
+    // After any equal keys, since this line comes last in the file.
+    size_t key_len = vars__index_key_len(last);
+    size_t position = vars__index_lower_bound(index, file->parsed_buf, last, key_len);
+    while (position < index->count && vars__index_compare_key(last, key_len, file->parsed_buf + index->offsets[position]) == 0) position++;
+    memmove(index->offsets + position + 1, index->offsets + position, (index->count - position) * sizeof(uint32_t));
+    index->offsets[position] = (uint32_t)(last - file->parsed_buf);
+    index->count++;
+    return 1;
+}
+
+static void vars__index_free(vars_index* index) {
+    if (!index) return;
+    VARS_FREE(index->offsets);
+    VARS_FREE(index);
+}
+
+// ---------------------------------------------
+// NUMBERS
+// ---------------------------------------------
+
+// Numbers are read and written here rather than with strtof, strtol and
+// printf. Those follow the C locale, so under one with a decimal comma
+// strtof stops at the '.' in "1.5", and "%.6f" both writes a comma and drops
+// digits. The results match strtof and strtol under the "C" locale.
+
+static const double vars__pow10[23] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// Longest text vars__format_float() writes, with the terminator. The
+// smallest floats need "-0." and 44 zeros before their digits.
+#define VARS_FLOAT_CHARS 64
+
+// mantissa * 10^exponent rounded to the nearest float, if that can be done
+// with one double operation. Both operands are exact doubles, so the double
+// result is the exact value correctly rounded, but rounding it again to float
+// is only right if it didn't land exactly halfway between two floats: the
+// exact value may have been just above or below that midpoint, and which one
+// is lost. Returns 0 for those and when the operands aren't exact.
+static int vars__float_fast_path(uint64_t mantissa, int exponent, float* out) {
+    if (mantissa > ((uint64_t)1 << 53) || exponent < -22 || exponent > 22) return 0;
+    double value = (double)mantissa;
+    value = exponent < 0 ? value / vars__pow10[-exponent] : value * vars__pow10[exponent];
+
+    // Every result is a normal float, between 1e-22 and 2^53 * 1e22, so the
+    // 29 low bits of the double's 52 are the ones the float drops. A midpoint
+    // has the top one of them set and the rest clear.
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    if ((bits & 0x1FFFFFFFu) == 0x10000000u) return 0;
+    *out = (float)value;
+    return 1;
+}
+
+// strtof for what the fast path can't round exactly, like long mantissas,
+// far exponents, hex, inf and nan. strtof wants the locale's decimal point,
+// so when that isn't '.' it reads a copy with the '.' swapped.
+static float vars__strtof_c(const char* text, const char** end) {
+    const char* point = localeconv()->decimal_point;
+    char* float_end;
+    if (!point || (point[0] == '.' && point[1] == '\0')) {
+        float value = strtof(text, &float_end);
+        *end = float_end;
+        return value;
+    }
+
+    // Only the characters a float can be made of are copied.
+    size_t point_len = strlen(point);
+    size_t len = 0, copy_len = 1;
+    while (isalnum((unsigned char)text[len]) || text[len] == '.' || text[len] == '+' || text[len] == '-') {
+        copy_len += text[len] == '.' ? point_len : 1;
+        len++;
+    }
+    char local[128];
+    char* copy = copy_len <= sizeof(local) ? local : (char*)VARS_MALLOC(copy_len);
+    if (!copy) {
+        *end = text;
+        return 0.0f;
+    }
+    char* cursor = copy;
+    for (size_t i = 0; i < len; i++) {
+        if (text[i] == '.') {
+            memcpy(cursor, point, point_len);
+            cursor += point_len;
+        } else {
+            *cursor++ = text[i];
+        }
+    }
+    *cursor = '\0';
+
+    float value = strtof(copy, &float_end);
+    size_t consumed = 0, copied = 0;
+    while (copied < (size_t)(float_end - copy)) copied += text[consumed++] == '.' ? point_len : 1;
+    *end = text + consumed;
+    if (copy != local) VARS_FREE(copy);
+    return value;
+}
+
+// Reads a float like strtof does. *end is where it stopped, or text when
+// there was no number.
+static float vars__parse_float(const char* text, const char** end) {
+    const char* cursor = text;
+    while (IS_WHITE_SPACE(*cursor) || IS_END_OF_LINE(*cursor)) cursor++;
+    const char* number = cursor;
+    int negative = *cursor == '-';
+    if (*cursor == '+' || *cursor == '-') cursor++;
+
+    // Up to 19 significant digits fit in the mantissa. Zeros after them are
+    // counted in the exponent, anything else needs the slow path.
+    uint64_t mantissa = 0;
+    int digits = 0, exponent = 0, exact = 1;
+    const char* first = cursor;
+    for (; IS_NUMBER(*cursor); cursor++) {
+        if (digits < 19) {
+            mantissa = mantissa * 10 + (uint64_t)(*cursor - '0');
+            digits += mantissa != 0;
+        } else {
+            exponent++;
+            exact &= *cursor == '0';
+        }
+    }
+    size_t whole_digits = (size_t)(cursor - first);
+    size_t fraction_digits = 0;
+    if (*cursor == '.') {
+        const char* fraction = ++cursor;
+        for (; IS_NUMBER(*cursor); cursor++) {
+            if (digits < 19) {
+                mantissa = mantissa * 10 + (uint64_t)(*cursor - '0');
+                digits += mantissa != 0;
+                exponent--;
+            } else {
+                exact &= *cursor == '0';
+            }
+        }
+        fraction_digits = (size_t)(cursor - fraction);
+    }
+
+    // No digits means inf, nan or no number at all, and "0x" is hex.
+    if (whole_digits + fraction_digits == 0 || (first[0] == '0' && (first[1] == 'x' || first[1] == 'X'))) {
+        const char* float_end;
+        float value = vars__strtof_c(number, &float_end);
+        *end = float_end == number ? text : float_end;
+        return value;
+    }
+
+    if (*cursor == 'e' || *cursor == 'E') {
+        const char* digit = cursor + 1;
+        int exponent_negative = *digit == '-';
+        if (*digit == '+' || *digit == '-') digit++;
+        if (IS_NUMBER(*digit)) {
+            int written = 0;
+            for (; IS_NUMBER(*digit); digit++) {
+                if (written < 100000) written = written * 10 + (*digit - '0');
+            }
+            exponent += exponent_negative ? -written : written;
+            cursor = digit;
+        }
+    }
+    *end = cursor;
+
+    float value;
+    if (mantissa == 0) {
+        value = 0.0f;
+    } else if (!exact || !vars__float_fast_path(mantissa, exponent, &value)) {
+        const char* float_end;
+        return vars__strtof_c(number, &float_end);
+    }
+    return negative ? -value : value;
+}
+
+// Reads a base 10 integer like strtol does, saturating at LONG_MIN and
+// LONG_MAX. *end is where it stopped, or text when there was no number.
+static long vars__parse_long(const char* text, const char** end) {
+    const char* cursor = text;
+    while (IS_WHITE_SPACE(*cursor) || IS_END_OF_LINE(*cursor)) cursor++;
+    int negative = *cursor == '-';
+    if (*cursor == '+' || *cursor == '-') cursor++;
+    if (!IS_NUMBER(*cursor)) {
+        *end = text;
+        return 0;
+    }
+
+    unsigned long limit = negative ? (unsigned long)LONG_MAX + 1 : (unsigned long)LONG_MAX;
+    unsigned long value = 0;
+    int overflow = 0;
+    for (; IS_NUMBER(*cursor); cursor++) {
+        unsigned long digit = (unsigned long)(*cursor - '0');
+        if (value > (limit - digit) / 10) overflow = 1;
+        else value = value * 10 + digit;
+    }
+    *end = cursor;
+
+    if (overflow) return negative ? LONG_MIN : LONG_MAX;
+    if (!negative) return (long)value;
+    return value > (unsigned long)LONG_MAX ? LONG_MIN : -(long)value;
+}
+
+// Writes digits with the decimal point after the first point of them, padding
+// with zeros on either side, so the text never needs an exponent. There is
+// always a '.', so the value still reads back as a float.
+static char* vars__write_decimal(char* out, const char* digits, int count, int point) {
+    if (point <= 0) {
+        *out++ = '0';
+        *out++ = '.';
+        for (int i = point; i < 0; i++) *out++ = '0';
+        memcpy(out, digits, (size_t)count);
+        return out + count;
+    }
+    if (point >= count) {
+        memcpy(out, digits, (size_t)count);
+        out += count;
+        for (int i = count; i < point; i++) *out++ = '0';
+        *out++ = '.';
+        *out++ = '0';
+        return out;
+    }
+    memcpy(out, digits, (size_t)point);
+    out += point;
+    *out++ = '.';
+    memcpy(out, digits + point, (size_t)(count - point));
+    return out + count - point;
+}
+
+// Writes the shortest decimal that reads back as exactly value, e.g. "0.1"
+// rather than "0.100000", and returns its length. out needs VARS_FLOAT_CHARS.
+static int vars__format_float(float value, char* out) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    char* cursor = out;
+    if (bits >> 31) *cursor++ = '-';
+    bits &= 0x7FFFFFFFu;
+    if (bits >= 0x7F800000u) {
+        memcpy(cursor, bits == 0x7F800000u ? "inf" : "nan", 4);
+        return (int)(cursor - out) + 3;
+    }
+    float magnitude;
+    memcpy(&magnitude, &bits, sizeof(magnitude));
+    double d = (double)magnitude;
+
+    char digits[24];
+    int count = 0, point = 0;
+    if (bits == 0) {
+        digits[count++] = '0';
+        point = 1;
+    } else {
+        // Scale so that p digits are left of the point, round, and check the
+        // nearest integers, for p = 1, 2, ... The check is an exact fast path
+        // parse, so the first hit is the shortest text that reads back.
+        int e10 = 0;
+        while (e10 < 22 && d >= vars__pow10[e10 + 1]) e10++;
+        if (d < 1.0) {
+            while (e10 > -22 && d * vars__pow10[-e10] < 1.0) e10--;
+        }
+        uint64_t found = 0;
+        int found_exponent = 0, hit = 0;
+        int in_range = d >= 1e-22 && d < 1e22;
+        for (int p = 1; p <= 9 && in_range && !hit; p++) {
+            int k = p - 1 - e10;
+            if (k > 22 || k < -22) break;
+            double scaled = k >= 0 ? d * vars__pow10[k] : d / vars__pow10[-k];
+            uint64_t nearest = (uint64_t)(scaled + 0.5);
+            uint64_t candidates[3] = { nearest, nearest + 1, nearest - 1 };
+            for (int c = 0; c < 3 && !hit; c++) {
+                float back;
+                if (candidates[c] == 0 || candidates[c] > nearest + 1) continue;
+                if (vars__float_fast_path(candidates[c], -k, &back) && back == magnitude) {
+                    found = candidates[c];
+                    found_exponent = -k;
+                    hit = 1;
+                }
+            }
+        }
+
+        if (hit) {
+            while (found % 10 == 0) {
+                found /= 10;
+                found_exponent++;
+            }
+            char reversed[24];
+            while (found) {
+                reversed[count++] = (char)('0' + found % 10);
+                found /= 10;
+            }
+            for (int i = 0; i < count; i++) digits[i] = reversed[count - 1 - i];
+            point = count + found_exponent;
+        } else {
+            // Floats past 1e22 or near the bottom of the range: take the
+            // shortest precision of "%e" that reads back. It is exact but slow.
+            for (int p = 1; p <= 9; p++) {
+                char scientific[40];
+                char decimal[VARS_FLOAT_CHARS];
+                snprintf(scientific, sizeof(scientific), "%.*e", p - 1, d);
+                count = 0;
+                const char* s = scientific;
+                for (; *s && *s != 'e'; s++) {
+                    if (IS_NUMBER(*s)) digits[count++] = *s;
+                }
+                const char* exponent_end;
+                point = (int)vars__parse_long(s + 1, &exponent_end) + 1;
+                *vars__write_decimal(decimal, digits, count, point) = '\0';
+                const char* end;
+                if (vars__parse_float(decimal, &end) == magnitude) break;
+            }
+            while (count > 1 && digits[count - 1] == '0') count--;
+        }
+    }
+
+    cursor = vars__write_decimal(cursor, digits, count, point);
+    *cursor = '\0';
+    return (int)(cursor - out);
+}
+
+// Writes "(x y ...)" for count components into out, which needs room for
+// count * VARS_FLOAT_CHARS + 2 bytes.
+static void vars__format_vec(const float* values, int count, char* out) {
+    *out++ = '(';
+    for (int i = 0; i < count; i++) {
+        if (i) *out++ = ' ';
+        out += vars__format_float(values[i], out);
+    }
+    *out++ = ')';
+    *out = '\0';
+}
+
+// ---------------------------------------------
+// HELPER FUNCTIONS 
+// ---------------------------------------------
+
+// Whole seconds would miss a second save within the same second, so this
+// uses nanoseconds wherever stat() has them.
+static int64_t vars__get_file_mod_time(const char* file_path) {
+    struct stat st;
+    if (stat(file_path, &st) != 0) return -1;
+#if defined(__APPLE__)
+    return (int64_t)st.st_mtimespec.tv_sec * 1000000000 + st.st_mtimespec.tv_nsec;
+#elif defined(_POSIX_C_SOURCE) && _POSIX_C_SOURCE >= 200809L
+    return (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+#elif defined(__GLIBC__) && defined(__USE_XOPEN2K8)
+    return (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+#elif defined(__GLIBC__)
+    // Strict modes like -std=c99 hide st_mtim, but glibc still has the nanoseconds.
+    return (int64_t)st.st_mtime * 1000000000 + (int64_t)st.st_mtimensec;
+#else
+    return (int64_t)st.st_mtime * 1000000000;
+#endif
+}
+
+// Parses size bytes of text into file's parsed_buf. The buffer isn't kept.
+static void vars__parse_buffer(vars_file* file, const char* buffer, size_t size) {
+    double started = vars__now();
+    file->parsed_buf = (char*)VARS_MALLOC(size * 2 + 1); // Extra space for subfolder prefixes
+    file->usage = (vars_usage*)VARS_MALLOC(sizeof(vars_usage));
+    file->index = (vars_index*)VARS_MALLOC(sizeof(vars_index));
+    if (!file->parsed_buf || !file->usage || !file->index) {
+        fprintf(stderr, "ERROR: vars_load: Memory allocation failed.\n");
         exit(EXIT_FAILURE);
     }
 
-    char* cursor = file.filebuf;
-    char* end_of_file = file.filebuf + file_size;
+    const char* cursor = buffer;
+    const char* end_of_file = buffer + size;
     char current_subfolder[256] = "";  // Current subfolder prefix
 
-    file.parsed_len = 0; // Reset parsed length
+    file->parsed_len = 0; // Reset parsed length
 
     while (cursor < end_of_file) {
         while (cursor < end_of_file && (IS_WHITE_SPACE(*cursor) || IS_END_OF_LINE(*cursor))) {
@@ -214,9 +890,7 @@ static vars_file vars__load_and_parse_file(const char* file_path) {
 
         while (cursor < end_of_file && !IS_END_OF_LINE(*cursor)) {
             if (*cursor == '#') {
-                while (cursor < end_of_file && !IS_END_OF_LINE(*cursor)) {
-                    cursor++;
-                }
+                cursor = vars__find_end_of_line(cursor, end_of_file);
                 break;
             }
 
@@ -236,12 +910,12 @@ static vars_file vars__load_and_parse_file(const char* file_path) {
                 
                 // Add subfolder declaration to parsed buffer
                 if (parsed_any) {
-                    file.parsed_buf[file.parsed_len++] = ' ';
+                    file->parsed_buf[file->parsed_len++] = ' ';
                 }
-                file.parsed_buf[file.parsed_len++] = ':';
-                file.parsed_buf[file.parsed_len++] = '/';
+                file->parsed_buf[file->parsed_len++] = ':';
+                file->parsed_buf[file->parsed_len++] = '/';
                 for (size_t i = 0; i < ns_len; i++) {
-                    file.parsed_buf[file.parsed_len++] = current_subfolder[i];
+                    file->parsed_buf[file->parsed_len++] = current_subfolder[i];
                 }
                 parsed_any = 1;
                 continue;
@@ -249,14 +923,15 @@ static vars_file vars__load_and_parse_file(const char* file_path) {
 
             if (*cursor == '"') {
                 if (parsed_any) {
-                    file.parsed_buf[file.parsed_len++] = ' ';
-                }
-                file.parsed_buf[file.parsed_len++] = *cursor++;
-                while (cursor < end_of_file && *cursor != '"' && !IS_END_OF_LINE(*cursor)) {
-                    file.parsed_buf[file.parsed_len++] = *cursor++;
+                    file->parsed_buf[file->parsed_len++] = ' ';
                 }
+                file->parsed_buf[file->parsed_len++] = *cursor++;
+                const char* string_end = vars__scan3(cursor, end_of_file, '"', '\n', '\r');
+                memcpy(file->parsed_buf + file->parsed_len, cursor, (size_t)(string_end - cursor));
+                file->parsed_len += (size_t)(string_end - cursor);
+                cursor = string_end;
                 if (cursor < end_of_file && *cursor == '"') {
-                    file.parsed_buf[file.parsed_len++] = *cursor++;
+                    file->parsed_buf[file->parsed_len++] = *cursor++;
                 } else {
                     fprintf(stderr, "ERROR: Unterminated string\n");
                 }
@@ -268,7 +943,7 @@ static vars_file vars__load_and_parse_file(const char* file_path) {
                 || IS_HYPHEN(*cursor) || IS_DOT(*cursor) || IS_PAREN(*cursor)) {
 
                 if (parsed_any) {
-                    file.parsed_buf[file.parsed_len++] = ' ';
+                    file->parsed_buf[file->parsed_len++] = ' ';
                 }
 
                 // Check if this is a key (first token on line after subfolder)
@@ -278,15 +953,15 @@ static vars_file vars__load_and_parse_file(const char* file_path) {
                 if (is_key && current_subfolder[0] != '\0') {
                     size_t ns_len = strlen(current_subfolder);
                     for (size_t i = 0; i < ns_len; i++) {
-                        file.parsed_buf[file.parsed_len++] = current_subfolder[i];
+                        file->parsed_buf[file->parsed_len++] = current_subfolder[i];
                     }
-                    file.parsed_buf[file.parsed_len++] = '/';
+                    file->parsed_buf[file->parsed_len++] = '/';
                 }
 
                 while (cursor < end_of_file &&
                        (IS_LETTER(*cursor) || IS_NUMBER(*cursor) || IS_UNDERSCORE(*cursor) ||
                         IS_HYPHEN(*cursor) || IS_DOT(*cursor) || IS_PAREN(*cursor))) {
-                    file.parsed_buf[file.parsed_len++] = *cursor++;
+                    file->parsed_buf[file->parsed_len++] = *cursor++;
                 }
 
                 parsed_any = 1;
@@ -297,7 +972,7 @@ static vars_file vars__load_and_parse_file(const char* file_path) {
         }
 
         if (parsed_any) {
-            file.parsed_buf[file.parsed_len++] = '\n';
+            file->parsed_buf[file->parsed_len++] = '\n';
         }
 
         while (cursor < end_of_file && IS_END_OF_LINE(*cursor)) {
@@ -305,15 +980,278 @@ static vars_file vars__load_and_parse_file(const char* file_path) {
         }
     }
 
-    file.parsed_buf[file.parsed_len] = '\0';
+    file->parsed_buf[file->parsed_len] = '\0';
+
+    memset(file->index, 0, sizeof(vars_index));
+    memset(file->usage, 0, sizeof(vars_usage));
+    file->usage->parse_seconds = vars__now() - started;
+}
+
+static vars_file vars__load_and_parse_file(const char* file_path) {
+    vars_file file = { 0 };
+
+    FILE* handle = fopen(file_path, "rb");
+    if (!handle) {
+        fprintf(stderr, "ERROR: vars_load: Failed to open file: %s\n", file_path);
+        exit(EXIT_FAILURE);
+    }
+
+    fseek(handle, 0, SEEK_END);
+    long file_size = ftell(handle);
+    rewind(handle);
+
+    if (file_size <= 0) {
+        fprintf(stderr, "ERROR: vars_load: Invalid file size.\n");
+        fclose(handle);
+        exit(EXIT_FAILURE);
+    }
+
+    file.filebuf = (char*)VARS_MALLOC(file_size);
+    if (!file.filebuf) {
+        fprintf(stderr, "ERROR: vars_load: Memory allocation failed.\n");
+        fclose(handle);
+        exit(EXIT_FAILURE);
+    }
+
+    size_t read = fread(file.filebuf, 1, file_size, handle);
+    fclose(handle);
+
+    if (read != (size_t)file_size) {
+        fprintf(stderr, "ERROR: vars_load: File read incomplete (%zu of %ld bytes).\n", read, file_size);
+        VARS_FREE(file.filebuf);
+        exit(EXIT_FAILURE);
+    }
+
+    vars__parse_buffer(&file, file.filebuf, (size_t)file_size);
+    file.usage->file_bytes = (size_t)file_size;
 
     return file;
 }
 
+// ---------------------------------------------
+// BATCHED SETS
+// ---------------------------------------------
+
+// Between vars_begin_batch() and vars_commit_batch(), sets are queued here
+// instead of rebuilding parsed_buf each time. Keys and values live in one
+// growing buffer and entries refer to them by offset, so growing it is safe.
+typedef struct {
+    size_t key;
+    size_t key_len;
+    size_t value;
+    size_t order; // Position of the first set of this key, for appending new keys.
+    const char* name; // Set by vars__batch_apply once the strings stop moving.
+    int found;
+} vars_batch_entry;
+
+struct vars_batch {
+    vars_batch_entry* entries;
+    size_t count;
+    size_t capacity;
+    char* strings;
+    size_t strings_len;
+    size_t strings_capacity;
+    int depth;
+};
+
+static int vars__batch_reserve(void** data, size_t* capacity, size_t needed, size_t item_size) {
+    if (needed <= *capacity) return 1;
+    size_t new_capacity = *capacity ? *capacity : 64;
+    while (new_capacity < needed) new_capacity *= 2;
+    void* new_data = VARS_REALLOC(*data, new_capacity * item_size);
+    if (!new_data) return 0;
+    *data = new_data;
+    *capacity = new_capacity;
+    return 1;
+}
+
+static int vars__batch_add(struct vars_batch* batch, const char* key, const char* value) {
+    size_t key_len = strlen(key);
+    size_t value_len = strlen(value);
+    if (!vars__batch_reserve((void**)&batch->entries, &batch->capacity, batch->count + 1, sizeof(vars_batch_entry)) ||
+        !vars__batch_reserve((void**)&batch->strings, &batch->strings_capacity,
+                             batch->strings_len + key_len + value_len + 2, 1)) {
+        return 0;
+    }
+
+    vars_batch_entry* entry = &batch->entries[batch->count];
+    entry->key = batch->strings_len;
+    entry->key_len = key_len;
+    memcpy(batch->strings + batch->strings_len, key, key_len + 1);
+    batch->strings_len += key_len + 1;
+    entry->value = batch->strings_len;
+    memcpy(batch->strings + batch->strings_len, value, value_len + 1);
+    batch->strings_len += value_len + 1;
+    entry->order = batch->count++;
+    entry->found = 0;
+    return 1;
+}
+
+// Latest queued value for a key, so gets during a batch see their own sets.
+static char* vars__batch_find(const struct vars_batch* batch, const char* key, size_t key_len) {
+    if (!batch) return NULL;
+    for (size_t i = batch->count; i-- > 0;) {
+        const vars_batch_entry* entry = &batch->entries[i];
+        if (entry->key_len == key_len && memcmp(batch->strings + entry->key, key, key_len) == 0) {
+            return batch->strings + entry->value;
+        }
+    }
+    return NULL;
+}
+
+static int vars__batch_compare_key(const void* a, const void* b) {
+    const vars_batch_entry* ea = (const vars_batch_entry*)a;
+    const vars_batch_entry* eb = (const vars_batch_entry*)b;
+    int cmp = vars__compare_bytes(ea->name, ea->key_len, eb->name, eb->key_len);
+    if (cmp != 0) return cmp;
+    return ea->order < eb->order ? -1 : ea->order > eb->order;
+}
+
+static int vars__batch_compare_order(const void* a, const void* b) {
+    const vars_batch_entry* ea = (const vars_batch_entry*)a;
+    const vars_batch_entry* eb = (const vars_batch_entry*)b;
+    return ea->order < eb->order ? -1 : ea->order > eb->order;
+}
+
+static vars_batch_entry* vars__batch_lookup(struct vars_batch* batch, const char* key, size_t key_len) {
+    size_t lo = 0, hi = batch->count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        vars_batch_entry* entry = &batch->entries[mid];
+        int cmp = vars__compare_bytes(entry->name, entry->key_len, key, key_len);
+        if (cmp == 0) return entry;
+        if (cmp < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    return NULL;
+}
+
+// Writes every queued set into a new parsed_buf in one pass. The result is the
+// same as doing the sets one at a time: existing lines are replaced in place
+// and new keys are appended in the order they were first set.
+static int vars__batch_apply(vars_file* file) {
+    struct vars_batch* batch = file->batch;
+    if (!batch || batch->count == 0) return 1;
+
+    // Sort by key, keeping the first position and the last value of each.
+    for (size_t i = 0; i < batch->count; i++) {
+        batch->entries[i].name = batch->strings + batch->entries[i].key;
+    }
+    qsort(batch->entries, batch->count, sizeof(vars_batch_entry), vars__batch_compare_key);
+    size_t unique = 0;
+    for (size_t i = 0; i < batch->count; i++) {
+        vars_batch_entry* entry = &batch->entries[i];
+        if (unique > 0) {
+            vars_batch_entry* last = &batch->entries[unique - 1];
+            if (last->key_len == entry->key_len && memcmp(last->name, entry->name, entry->key_len) == 0) {
+                last->value = entry->value;
+                continue;
+            }
+        }
+        batch->entries[unique++] = *entry;
+    }
+    batch->count = unique;
+
+    size_t new_capacity = file->parsed_len + 1;
+    for (size_t i = 0; i < batch->count; i++) {
+        new_capacity += batch->entries[i].key_len + strlen(batch->strings + batch->entries[i].value) + 2;
+    }
+    char* new_buf = (char*)VARS_MALLOC(new_capacity);
+    if (!new_buf) return 0;
+
+    const char* src = file->parsed_buf;
+    char* dst = new_buf;
+    while (*src) {
+        const char* line = src;
+        while (*src && !IS_WHITE_SPACE(*src) && !IS_END_OF_LINE(*src)) src++;
+        vars_batch_entry* entry = NULL;
+        if (*line != ':' && IS_WHITE_SPACE(*src)) {
+            entry = vars__batch_lookup(batch, line, (size_t)(src - line));
+        }
+
+        if (entry) {
+            const char* value = batch->strings + entry->value;
+            size_t value_len = strlen(value);
+            memcpy(dst, line, entry->key_len);
+            dst += entry->key_len;
+            *dst++ = ' ';
+            memcpy(dst, value, value_len);
+            dst += value_len;
+            entry->found = 1;
+            while (*src && !IS_END_OF_LINE(*src)) src++;
+        } else {
+            while (*src && !IS_END_OF_LINE(*src)) src++;
+            memcpy(dst, line, (size_t)(src - line));
+            dst += src - line;
+        }
+        if (*src) *dst++ = *src++;
+    }
+
+    qsort(batch->entries, batch->count, sizeof(vars_batch_entry), vars__batch_compare_order);
+    for (size_t i = 0; i < batch->count; i++) {
+        vars_batch_entry* entry = &batch->entries[i];
+        if (entry->found) continue;
+        const char* value = batch->strings + entry->value;
+        size_t value_len = strlen(value);
+        memcpy(dst, entry->name, entry->key_len);
+        dst += entry->key_len;
+        *dst++ = ' ';
+        memcpy(dst, value, value_len);
+        dst += value_len;
+        *dst++ = '\n';
+    }
+    *dst = '\0';
+
+    VARS_FREE(file->parsed_buf);
+    file->parsed_buf = new_buf;
+    file->parsed_len = dst - new_buf;
+    file->generation++;
+
+    batch->count = 0;
+    batch->strings_len = 0;
+    return 1;
+}
+
+static void vars__batch_free(struct vars_batch* batch) {
+    if (!batch) return;
+    VARS_FREE(batch->entries);
+    VARS_FREE(batch->strings);
+    VARS_FREE(batch);
+}
+
+VARSAPI int vars_begin_batch(vars_file* file) {
+    if (!file || !file->parsed_buf) return 0;
+    if (!file->batch) {
+        file->batch = (struct vars_batch*)VARS_MALLOC(sizeof(struct vars_batch));
+        if (!file->batch) return 0;
+        memset(file->batch, 0, sizeof(struct vars_batch));
+    }
+    file->batch->depth++;
+    return 1;
+}
+
+VARSAPI int vars_commit_batch(vars_file* file) {
+    if (!file || !file->batch) return 0;
+    if (--file->batch->depth > 0) return 1;
+
+    int result = vars__batch_apply(file);
+    vars__batch_free(file->batch);
+    file->batch = NULL;
+    return result;
+}
+
 static char* vars__find_key_value(const char* key, vars_file file) {
     char* p = file.parsed_buf;
     size_t key_len = strlen(key);
     
+    char* queued = vars__batch_find(file.batch, key, key_len);
+    if (queued) return queued;
+
+    // Keys with whitespace can only be matched by the scan.
+    if (key_len > 0 && vars__index_key_len(key) == key_len && vars__index_ready(file)) {
+        return vars__index_find(file, key, key_len);
+    }
+    
     while (*p) {
         // Skip subfolder declarations
         if (*p == ':' && *(p+1) == '/') {
@@ -335,15 +1273,17 @@ static char* vars__find_key_value(const char* key, vars_file file) {
 
 static int vars__update_or_add_key(const char* key, const char* value, vars_file* file) {
     if (!file || !key || !value) return 0;
+    if (file->batch) return vars__batch_add(file->batch, key, value);
     
     size_t new_capacity = file->parsed_len + strlen(key) + strlen(value) + 100; // Extra space
-    char* new_buf = (char*)malloc(new_capacity);
+    char* new_buf = (char*)VARS_MALLOC(new_capacity);
     if (!new_buf) return 0;
     
     char* src = file->parsed_buf;
     char* dst = new_buf;
     size_t key_len = strlen(key);
     int key_found = 0;
+    size_t match_start = SIZE_MAX, match_old_len = 0, match_new_len = 0;
     
     while (*src) {
         if (*src == ':' && *(src+1) == '/') {
@@ -355,7 +1295,9 @@ static int vars__update_or_add_key(const char* key, const char* value, vars_file
         }
         
         if (strncmp(src, key, key_len) == 0 && IS_WHITE_SPACE(src[key_len])) {
-            key_found = 1;
+            key_found++;
+            match_start = (size_t)(src - file->parsed_buf);
+            char* line = dst;
             
             strcpy(dst, key);
             dst += key_len;
@@ -365,6 +1307,8 @@ static int vars__update_or_add_key(const char* key, const char* value, vars_file
             dst += strlen(value);
             
             while (*src && !IS_END_OF_LINE(*src)) src++;
+            match_old_len = (size_t)(src - file->parsed_buf) - match_start;
+            match_new_len = (size_t)(dst - line);
             
             if (*src) *dst++ = *src++;
         } else {
@@ -386,9 +1330,20 @@ static int vars__update_or_add_key(const char* key, const char* value, vars_file
     
     *dst = '\0';
     
-    free(file->parsed_buf);
+    // The index can follow one rewritten or appended line, as long as no
+    // newline in the key or value turned it into several.
+    vars_index* index = file->index;
+    int patch = index && index->built && index->generation == file->generation && key_found <= 1
+             && !strpbrk(key, "\r\n") && !strpbrk(value, "\r\n");
+
+    VARS_FREE(file->parsed_buf);
     file->parsed_buf = new_buf;
     file->parsed_len = dst - new_buf;
+    file->generation++;
+
+    if (patch && vars__index_patch(index, file, match_start, match_old_len, match_new_len)) {
+        index->generation = file->generation;
+    }
     
     return 1;
 }
@@ -402,7 +1357,7 @@ VARSAPI int vars_set_string(char* key, const char* value, vars_file* file) {
     
     // Format as quoted string
     size_t len = strlen(value);
-    char* quoted_value = (char*)malloc(len + 3); // +2 for quotes, +1 for null terminator
+    char* quoted_value = (char*)VARS_MALLOC(len + 3); // +2 for quotes, +1 for null terminator
     if (!quoted_value) return 0;
     
     quoted_value[0] = '"';
@@ -411,15 +1366,15 @@ VARSAPI int vars_set_string(char* key, const char* value, vars_file* file) {
     quoted_value[len + 2] = '\0';
     
     int result = vars__update_or_add_key(key, quoted_value, file);
-    free(quoted_value);
+    VARS_FREE(quoted_value);
     return result;
 }
 
 VARSAPI int vars_set_float(char* key, float value, vars_file* file) {
     if (!key || !file) return 0;
     
-    char buffer[32];
-    snprintf(buffer, sizeof(buffer), "%.6f", value);
+    char buffer[VARS_FLOAT_CHARS];
+    vars__format_float(value, buffer);
     return vars__update_or_add_key(key, buffer, file);
 }
 
@@ -440,38 +1395,122 @@ VARSAPI int vars_set_bool(char* key, int value, vars_file* file) {
 VARSAPI int vars_set_vec2(char* key, vars_vec2 value, vars_file* file) {
     if (!key || !file) return 0;
     
-    char buffer[64];
-    snprintf(buffer, sizeof(buffer), "(%.6f %.6f)", value.x, value.y);
+    char buffer[2 * VARS_FLOAT_CHARS + 2];
+    vars__format_vec((const float*)&value, 2, buffer);
     return vars__update_or_add_key(key, buffer, file);
 }
 
 VARSAPI int vars_set_vec3(char* key, vars_vec3 value, vars_file* file) {
     if (!key || !file) return 0;
     
-    char buffer[96];
-    snprintf(buffer, sizeof(buffer), "(%.6f %.6f %.6f)", value.x, value.y, value.z);
+    char buffer[3 * VARS_FLOAT_CHARS + 2];
+    vars__format_vec((const float*)&value, 3, buffer);
     return vars__update_or_add_key(key, buffer, file);
 }
 
 VARSAPI int vars_set_vec4(char* key, vars_vec4 value, vars_file* file) {
     if (!key || !file) return 0;
     
-    char buffer[128];
-    snprintf(buffer, sizeof(buffer), "(%.6f %.6f %.6f %.6f)", value.x, value.y, value.z, value.w);
+    char buffer[4 * VARS_FLOAT_CHARS + 2];
+    vars__format_vec((const float*)&value, 4, buffer);
     return vars__update_or_add_key(key, buffer, file);
 }
 
+// ---------------------------------------------
+// ATOMIC WRITES
+// ---------------------------------------------
+
+#define VARS_TEMP_ATTEMPTS 100
+
+// Creates a temp file next to file_path and returns its descriptor, or -1.
+// The name holds the process id and a counter and is created exclusively, so
+// two processes or threads saving the same file never share a temp file.
+// temp_path needs room for the path and 40 more characters.
+static int vars__create_temp(const char* file_path, char* temp_path, size_t temp_size, int mode, int binary) {
+    static unsigned int counter = 0; // Only a hint. O_EXCL settles any race on it.
+    for (int attempt = 0; attempt < VARS_TEMP_ATTEMPTS; attempt++) {
+#ifdef _WIN32
+        (void)mode;
+        snprintf(temp_path, temp_size, "%s.%lu.%u.tmp", file_path, (unsigned long)GetCurrentProcessId(), counter++);
+        int fd = _open(temp_path, _O_WRONLY | _O_CREAT | _O_EXCL | (binary ? _O_BINARY : _O_TEXT), _S_IREAD | _S_IWRITE);
+#else
+        (void)binary;
+        snprintf(temp_path, temp_size, "%s.%ld.%u.tmp", file_path, (long)getpid(), counter++);
+        int fd = open(temp_path, O_WRONLY | O_CREAT | O_EXCL, (mode_t)mode);
+#endif
+        if (fd >= 0 || errno != EEXIST) return fd;
+    }
+    return -1;
+}
+
+// Writes data to a temp file, flushes it to disk and renames it over path,
+// so a crash leaves either the old file or the new one, never half of each.
+// Renaming also means a file someone has mapped keeps its old contents.
+// Text mode only matters on Windows, where it writes \r\n line endings.
+static int vars__write_file_atomic(const char* file_path, const char* data, size_t len, int binary) {
+    size_t temp_size = strlen(file_path) + 41;
+    char* temp_path = (char*)VARS_MALLOC(temp_size);
+    if (!temp_path) return 0;
+
+#ifdef _WIN32
+    int fd = vars__create_temp(file_path, temp_path, temp_size, 0, binary);
+    FILE* fp = fd >= 0 ? _fdopen(fd, binary ? "wb" : "w") : NULL;
+    if (fd >= 0 && !fp) _close(fd);
+    int ok = fp != NULL;
+    if (ok) {
+        ok = fwrite(data, 1, len, fp) == len && fflush(fp) == 0 && _commit(_fileno(fp)) == 0;
+        if (fclose(fp) != 0) ok = 0;
+    }
+    if (ok && !MoveFileExA(temp_path, file_path, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) ok = 0;
+    if (!ok && fd >= 0) remove(temp_path);
+#else
+    // Keep the permissions of the file being replaced.
+    struct stat st;
+    mode_t mode = stat(file_path, &st) == 0 ? (st.st_mode & 07777) : 0666;
+    int fd = vars__create_temp(file_path, temp_path, temp_size, (int)mode, binary);
+    int ok = fd >= 0;
+    size_t written = 0;
+    while (ok && written < len) {
+        ssize_t n = write(fd, data + written, len - written);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) ok = 0;
+        else written += (size_t)n;
+    }
+    if (ok && fsync(fd) != 0) ok = 0;
+    if (fd >= 0 && close(fd) != 0) ok = 0;
+    if (ok && rename(temp_path, file_path) != 0) ok = 0;
+
+    if (!ok) {
+        if (fd >= 0) remove(temp_path);
+    } else {
+        // The rename itself is only durable once the directory is synced.
+        // temp_path is long enough to hold the directory name.
+        const char* slash = strrchr(file_path, '/');
+        size_t dir_len = slash ? (slash == file_path ? 1 : (size_t)(slash - file_path)) : 1;
+        memcpy(temp_path, slash ? file_path : ".", dir_len);
+        temp_path[dir_len] = '\0';
+        int dir_fd = open(temp_path, O_RDONLY);
+        if (dir_fd >= 0) {
+            fsync(dir_fd);
+            close(dir_fd);
+        }
+    }
+#endif
+    VARS_FREE(temp_path);
+    return ok;
+}
+
 // ---------------------------------------------
 // SAVING
 // ---------------------------------------------
 
-VARSAPI int vars_save(vars_file* file) {
-    if (!file || !file->file_path) return 0;
-    
+// Writes the whole file into one buffer, sorted by section and key.
+static char* vars__serialize(vars_file* file, size_t* out_len) {
     vars_entry_list list;
     vars_entry_list_init(&list);
     
     char* p = file->parsed_buf;
+    size_t size = 1;
     
     while (*p) {
         // Skip subfolder declarations
@@ -492,9 +1531,6 @@ VARSAPI int vars_save(vars_file* file) {
         }
         
         size_t key_len = p - key_start;
-        char* key = (char*)malloc(key_len + 1);
-        strncpy(key, key_start, key_len);
-        key[key_len] = '\0';
         
         // Skip whitespace
         while (*p && IS_WHITE_SPACE(*p)) p++;
@@ -503,64 +1539,115 @@ VARSAPI int vars_save(vars_file* file) {
         char* value_start = p;
         while (*p && !IS_END_OF_LINE(*p)) p++;
         
-        size_t value_len = p - value_start;
-        char* value = (char*)malloc(value_len + 1);
-        strncpy(value, value_start, value_len);
-        value[value_len] = '\0';
-        
         // Split key into section and key parts
-        char* slash = strchr(key, '/');
-        if (slash) {
-            *slash = '\0';
-            vars_entry_list_add(&list, key, slash + 1, value);
-        } else {
-            vars_entry_list_add(&list, NULL, key, value);
+        vars_entry entry;
+        const char* slash = (const char*)memchr(key_start, '/', key_len);
+        entry.section = slash ? key_start : NULL;
+        entry.section_len = slash ? (size_t)(slash - key_start) : 0;
+        entry.key = slash ? slash + 1 : key_start;
+        entry.key_len = slash ? key_len - entry.section_len - 1 : key_len;
+        entry.value = value_start;
+        entry.value_len = (size_t)(p - value_start);
+        if (!vars_entry_list_add(&list, &entry)) {
+            vars_entry_list_free(&list);
+            return NULL;
         }
-        
-        free(key);
-        free(value);
+        // Room for "\n:/section\n" before it and "key value\n" itself.
+        size += entry.section_len + 4 + entry.key_len + entry.value_len + 2;
         
         // Skip newline
         if (*p) p++;
     }
     
-    qsort(list.entries, list.count, sizeof(vars_entry), vars_entry_compare);
+    if (list.count) qsort(list.entries, list.count, sizeof(vars_entry), vars_entry_compare);
     
-    // Write to file
-    FILE* fp = fopen(file->file_path, "w");
-    if (!fp) {
+    char* out = (char*)VARS_MALLOC(size);
+    if (!out) {
         vars_entry_list_free(&list);
-        return 0;
+        return NULL;
     }
     
-    const char* current_section = NULL;
+    char* cursor = out;
+    const vars_entry* current_section = NULL;
     
     for (size_t i = 0; i < list.count; i++) {
         vars_entry* entry = &list.entries[i];
         
         // Check if we need to write a section header
         if (entry->section) {
-            if (!current_section || strcmp(current_section, entry->section) != 0) {
-                if (i > 0) fprintf(fp, "\n"); // new line before new section.
-                fprintf(fp, ":/%s\n", entry->section);
-                current_section = entry->section;
+            if (!current_section || vars__compare_bytes(current_section->section, current_section->section_len,
+                                                        entry->section, entry->section_len) != 0) {
+                if (i > 0) *cursor++ = '\n'; // new line before new section.
+                *cursor++ = ':';
+                *cursor++ = '/';
+                memcpy(cursor, entry->section, entry->section_len);
+                cursor += entry->section_len;
+                *cursor++ = '\n';
+                current_section = entry;
             }
         } else {
             if (current_section) {
-                if (i > 0) fprintf(fp, "\n"); // new line before global section
+                if (i > 0) *cursor++ = '\n'; // new line before global section
                 current_section = NULL;
             }
         }
         
-        fprintf(fp, "%s %s\n", entry->key, entry->value);
+        memcpy(cursor, entry->key, entry->key_len);
+        cursor += entry->key_len;
+        *cursor++ = ' ';
+        memcpy(cursor, entry->value, entry->value_len);
+        cursor += entry->value_len;
+        *cursor++ = '\n';
     }
+    *cursor = '\0';
     
-    fclose(fp);
     vars_entry_list_free(&list);
+    *out_len = (size_t)(cursor - out);
+    return out;
+}
+
+// The file is replaced with a rename, so a crash or a full disk mid-save
+// leaves the old contents in place.
+VARSAPI int vars_save(vars_file* file) {
+    if (!file || !file->file_path) return 0;
     
-    file->last_modified = vars__get_file_mod_time(file->file_path);
+    // Queued sets are written too, and the batch stays open.
+    if (!vars__batch_apply(file)) return 0;
     
-    return 1;
+    size_t len = 0;
+    char* out = vars__serialize(file, &len);
+    if (!out) return 0;
+    
+    int ok = vars__write_file_atomic(file->file_path, out, len, 0);
+    VARS_FREE(out);
+    
+    if (ok) file->last_modified = vars__get_file_mod_time(file->file_path);
+    
+    return ok;
+}
+
+// Returns what vars_save() would write, without touching the disk, or NULL if
+// memory runs out. Free it with vars_free_memory().
+VARSAPI char* vars_save_to_memory(vars_file* file, size_t* out_len) {
+    if (!file || !file->parsed_buf) return NULL;
+    if (!vars__batch_apply(file)) return NULL;
+    
+    size_t len = 0;
+    char* out = vars__serialize(file, &len);
+    if (out && out_len) *out_len = len;
+    return out;
+}
+
+VARSAPI void vars_free_memory(void* memory) {
+    VARS_FREE(memory);
+}
+
+// Replaces the file at file_path with data the same way vars_save() does.
+// Together with vars_save_to_memory() this lets a worker thread do the disk
+// work. Files loaded from file_path see the change on their next vars_hot_load().
+VARSAPI int vars_write_file(const char* file_path, const char* data, size_t len) {
+    if (!file_path || !data) return 0;
+    return vars__write_file_atomic(file_path, data, len, 0);
 }
 
 // ---------------------------------------------
@@ -572,37 +1659,43 @@ VARSAPI int vars_hot_load(vars_file* file) {
         return 0;
     }
 
-    long current_mod_time = vars__get_file_mod_time(file->file_path);
+    int64_t current_mod_time = vars__get_file_mod_time(file->file_path);
     if (current_mod_time == -1) {
         return 0;
     }
 
-    if (current_mod_time <= file->last_modified) {
+    // Any difference counts, so restoring an older copy reloads too.
+    if (current_mod_time == file->last_modified) {
         return 0;
     }
 
+    double started = vars__now();
     vars_file new_file = vars__load_and_parse_file(file->file_path);
     
-    size_t path_len = strlen(file->file_path);
-    new_file.file_path = (char*)malloc(path_len + 1);
-    if (!new_file.file_path) {
-        fprintf(stderr, "ERROR: vars_hot_load: Memory allocation failed.\n");
-        vars_free(new_file);
-        return 0;
-    }
-    strcpy(new_file.file_path, file->file_path);
+    // The path carries over to the new buffers
+    new_file.file_path = file->file_path;
     new_file.last_modified = current_mod_time;
+    new_file.generation = file->generation + 1;
+    new_file.batch = file->batch;
+
+    // So do the counters and the time of the first parse.
+    if (file->usage) {
+        file->usage->file_bytes = new_file.usage->file_bytes;
+        VARS_FREE(new_file.usage);
+        new_file.usage = file->usage;
+    }
+    new_file.usage->reload_seconds = vars__now() - started;
 
-    if (file->filebuf) free(file->filebuf);
-    if (file->parsed_buf) free(file->parsed_buf);
+    if (file->filebuf) VARS_FREE(file->filebuf);
+    if (file->parsed_buf) VARS_FREE(file->parsed_buf);
+    vars__index_free(file->index);
 
     *file = new_file;
     
     return 1; // 1 for success.
 }
 
-VARSAPI char* vars_get_string(char* key, vars_file file, char* buffer) {
-    const char* val = vars__find_key_value(key, file);
+static char* vars__value_to_string(const char* val, char* buffer) {
     if (!val) return NULL;
 
     if (*val != '"') return NULL;  // Must start with quote
@@ -621,23 +1714,21 @@ VARSAPI char* vars_get_string(char* key, vars_file file, char* buffer) {
     return buffer;
 }
 
-VARSAPI float vars_get_float(char* key, vars_file file) {
-    const char* val = vars__find_key_value(key, file);
+static float vars__value_to_float(const char* val) {
     if (!val) return 0.0f; 
 
-    char* endptr;
-    float f = strtof(val, &endptr);
+    const char* endptr;
+    float f = vars__parse_float(val, &endptr);
     if (val == endptr) return 0.0f;
 
     return f;
 }
 
-VARSAPI int vars_get_int(char* key, vars_file file) {
-    const char* val = vars__find_key_value(key, file);
+static int vars__value_to_int(const char* val) {
     if (!val) return INT_MIN;
 
-    char* endptr;
-    long i = strtol(val, &endptr, 10);
+    const char* endptr;
+    long i = vars__parse_long(val, &endptr);
     if (val == endptr) return INT_MIN;
 
     return (int)i;
@@ -652,8 +1743,8 @@ static int vars__parse_vec(const char* val, float* out, int count) {
 
         if (!*val) return 0;
 
-        char* endptr;
-        out[i] = strtof(val, &endptr);
+        const char* endptr;
+        out[i] = vars__parse_float(val, &endptr);
         if (val == endptr) return 0;
 
         val = endptr;
@@ -665,32 +1756,28 @@ static int vars__parse_vec(const char* val, float* out, int count) {
     return 1;
 }
 
-VARSAPI vars_vec2 vars_get_vec2(char* key, vars_file file) {
+static vars_vec2 vars__value_to_vec2(const char* val) {
     vars_vec2 v = {0,0};
-    const char* val = vars__find_key_value(key, file);
     if (!val) return v;
     if (!vars__parse_vec(val, (float*)&v, 2)) return v;
     return v;
 }
 
-VARSAPI vars_vec3 vars_get_vec3(char* key, vars_file file) {
+static vars_vec3 vars__value_to_vec3(const char* val) {
     vars_vec3 v = {0,0,0};
-    const char* val = vars__find_key_value(key, file);
     if (!val) return v;
     if (!vars__parse_vec(val, (float*)&v, 3)) return v;
     return v;
 }
 
-VARSAPI vars_vec4 vars_get_vec4(char* key, vars_file file) {
+static vars_vec4 vars__value_to_vec4(const char* val) {
     vars_vec4 v = {0,0,0,0};
-    const char* val = vars__find_key_value(key, file);
     if (!val) return v;
     if (!vars__parse_vec(val, (float*)&v, 4)) return v;
     return v;
 }
 
-VARSAPI int vars_get_bool(char* key, vars_file file) {
-    const char* val = vars__find_key_value(key, file);
+static int vars__value_to_bool(const char* val) {
     if (!val) return 0;
 
     if (strncmp(val, "true", 4) == 0 && !isalnum((unsigned char)val[4])) {
@@ -703,10 +1790,161 @@ VARSAPI int vars_get_bool(char* key, vars_file file) {
     return -1; // return this on failure
 }
 
+// Looks up a key for a getter, counting it for vars_get_stats().
+static const char* vars__get_value(const char* key, vars_file file) {
+    const char* val = vars__find_key_value(key, file);
+    VARS_COUNT_LOOKUP(file.usage, val);
+    return val;
+}
+
+VARSAPI char* vars_get_string(char* key, vars_file file, char* buffer) {
+    return vars__value_to_string(vars__get_value(key, file), buffer);
+}
+
+VARSAPI float vars_get_float(char* key, vars_file file) {
+    return vars__value_to_float(vars__get_value(key, file));
+}
+
+VARSAPI int vars_get_int(char* key, vars_file file) {
+    return vars__value_to_int(vars__get_value(key, file));
+}
+
+VARSAPI vars_vec2 vars_get_vec2(char* key, vars_file file) {
+    return vars__value_to_vec2(vars__get_value(key, file));
+}
+
+VARSAPI vars_vec3 vars_get_vec3(char* key, vars_file file) {
+    return vars__value_to_vec3(vars__get_value(key, file));
+}
+
+VARSAPI vars_vec4 vars_get_vec4(char* key, vars_file file) {
+    return vars__value_to_vec4(vars__get_value(key, file));
+}
+
+VARSAPI int vars_get_bool(char* key, vars_file file) {
+    return vars__value_to_bool(vars__get_value(key, file));
+}
+
+// ---------------------------------------------
+// HANDLES
+// ---------------------------------------------
+
+#define VARS_INVALID_OFFSET ((size_t)-1)
+
+VARSAPI vars_handle vars_resolve(const char* key, vars_file file) {
+    vars_handle handle;
+    handle.key = key;
+    handle.offset = VARS_INVALID_OFFSET;
+    handle.generation = file.generation;
+    if (!key || !file.parsed_buf) return handle;
+
+    // Offsets are into parsed_buf, so look past any queued set;
+    // vars__handle_value() checks the batch itself.
+    file.batch = NULL;
+    const char* val = vars__find_key_value(key, file);
+    if (val) handle.offset = (size_t)(val - file.parsed_buf);
+    return handle;
+}
+
+static const char* vars__handle_value(vars_handle* handle, vars_file file) {
+    if (!handle || !handle->key || !file.parsed_buf) return NULL;
+    if (file.batch) {
+        const char* queued = vars__batch_find(file.batch, handle->key, strlen(handle->key));
+        if (queued) {
+            VARS_COUNT_LOOKUP(file.usage, 1);
+            return queued;
+        }
+    }
+    if (handle->generation != file.generation) {
+        *handle = vars_resolve(handle->key, file);
+    }
+    VARS_COUNT_LOOKUP(file.usage, handle->offset != VARS_INVALID_OFFSET);
+    if (handle->offset == VARS_INVALID_OFFSET) return NULL;
+    return file.parsed_buf + handle->offset;
+}
+
+VARSAPI char* vars_get_string_h(vars_handle* handle, vars_file file, char* buffer) {
+    return vars__value_to_string(vars__handle_value(handle, file), buffer);
+}
+
+VARSAPI float vars_get_float_h(vars_handle* handle, vars_file file) {
+    return vars__value_to_float(vars__handle_value(handle, file));
+}
+
+VARSAPI int vars_get_int_h(vars_handle* handle, vars_file file) {
+    return vars__value_to_int(vars__handle_value(handle, file));
+}
+
+VARSAPI vars_vec2 vars_get_vec2_h(vars_handle* handle, vars_file file) {
+    return vars__value_to_vec2(vars__handle_value(handle, file));
+}
+
+VARSAPI vars_vec3 vars_get_vec3_h(vars_handle* handle, vars_file file) {
+    return vars__value_to_vec3(vars__handle_value(handle, file));
+}
+
+VARSAPI vars_vec4 vars_get_vec4_h(vars_handle* handle, vars_file file) {
+    return vars__value_to_vec4(vars__handle_value(handle, file));
+}
+
+VARSAPI int vars_get_bool_h(vars_handle* handle, vars_file file) {
+    return vars__value_to_bool(vars__handle_value(handle, file));
+}
+
+// Reports what a loaded file holds and costs. parsed_buf is scanned once, so
+// this is meant for profiling, not for every frame. Sets still queued in a
+// batch aren't counted.
+VARSAPI int vars_get_stats(vars_file* file, vars_stats* stats) {
+    if (!file || !stats) return 0;
+    memset(stats, 0, sizeof(*stats));
+    if (file->parsed_buf) stats->parsed_bytes = file->parsed_len + 1;
+
+    const char* p = file->parsed_buf;
+    while (p && *p) {
+        const char* line_end = p;
+        while (*line_end && !IS_END_OF_LINE(*line_end)) line_end++;
+
+        if (p[0] == ':' && p[1] == '/') {
+            stats->sections++;
+        } else {
+            const char* key_end = p;
+            while (key_end < line_end && !IS_WHITE_SPACE(*key_end)) key_end++;
+            const char* value = key_end;
+            while (value < line_end && IS_WHITE_SPACE(*value)) value++;
+            stats->entries++;
+            stats->key_bytes += (size_t)(key_end - p);
+            stats->value_bytes += (size_t)(line_end - value);
+        }
+        p = *line_end ? line_end + 1 : line_end;
+    }
+
+    if (file->index) stats->index_bytes = file->index->capacity * sizeof(uint32_t);
+
+    if (file->usage) {
+        stats->file_bytes = file->usage->file_bytes;
+        stats->parse_seconds = file->usage->parse_seconds;
+        stats->reload_seconds = file->usage->reload_seconds;
+        stats->lookups = file->usage->lookups;
+        stats->misses = file->usage->misses;
+    }
+    return 1;
+}
+
+// Returns 0 if the index can't be built, e.g. for a buffer over 4 GB. Gets
+// then keep scanning.
+VARSAPI int vars_build_index(vars_file* file) {
+    if (!file || !file->index || !file->parsed_buf) return 0;
+    if (file->index->built && file->index->generation == file->generation) return 1;
+    return vars__index_build(file->index, *file);
+}
+
 VARSAPI int vars_free(vars_file file) {
-    if (file.filebuf) free(file.filebuf);
-    if (file.parsed_buf) free(file.parsed_buf);
-    if (file.file_path) free(file.file_path);
+    if (file.filebuf) VARS_FREE(file.filebuf);
+    if (file.parsed_buf) VARS_FREE(file.parsed_buf);
+    if (file.file_path) VARS_FREE(file.file_path);
+    if (file.usage) VARS_FREE(file.usage);
+    vars__index_free(file.index);
+    vars__batch_free(file.batch);
     return 0;
 }
 
@@ -715,7 +1953,7 @@ VARSAPI vars_file vars_load(const char* file_path) {
     
     // Store file path and modification time for hot reload
     size_t path_len = strlen(file_path);
-    file.file_path = (char*)malloc(path_len + 1);
+    file.file_path = (char*)VARS_MALLOC(path_len + 1);
     if (!file.file_path) {
         fprintf(stderr, "ERROR: vars_load: Memory allocation failed for file path.\n");
         vars_free(file);
@@ -727,4 +1965,19 @@ VARSAPI vars_file vars_load(const char* file_path) {
     return file;
 }
 
+// Parses text that is already in memory, e.g. read from an archive. The
+// parsed file keeps no pointer into buffer. It has no path, so
+// vars_hot_load() and vars_save() return 0.
+VARSAPI vars_file vars_load_memory(const char* buffer, size_t len, int flags) {
+    vars_file file = { 0 };
+    if (!buffer && len) {
+        fprintf(stderr, "ERROR: vars_load_memory: No buffer.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    vars__parse_buffer(&file, buffer ? buffer : "", len);
+    if (flags == VARS_MEMORY_OWN && buffer) VARS_FREE((void*)buffer);
+    return file;
+}
+
 #endif // VARS_IMPLEMENTATION
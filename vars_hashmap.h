@@ -9,18 +9,139 @@
 #define VARS_H
 
 typedef struct {
-    char* filebuf;
-    char* parsed_buf;
-    size_t parsed_len;
+    char* filebuf; // The file's contents. Keys and values point into it.
+    size_t filebuf_len;
+    int storage;   // Whether filebuf is heap memory or a read-only mapping.
     struct vars_map* map;
+    struct vars_binary* binary; // Set instead of map for files from vars_load_binary().
+    struct vars_listeners* listeners;
+    struct vars_journal* journal; // Set by vars_journal_open().
     char* file_path;
-    long last_modified;
+    int64_t last_modified; // In nanoseconds, where the platform has them.
 } vars_file;
 
+// Flags for vars_load_memory()
+#define VARS_MEMORY_BORROW 0 // Point into the caller's buffer, which must outlive the file.
+#define VARS_MEMORY_OWN    1 // Take the buffer, allocated with VARS_MALLOC, and free it in vars_free().
+#define VARS_MEMORY_COPY   2 // Copy the buffer, so the caller can free it right away.
+
 typedef struct { float x, y; } vars_vec2;
 typedef struct { float x, y, z; } vars_vec3;
 typedef struct { float x, y, z, w; } vars_vec4;
 
+// A key resolved to its slot in the hashmap. Getters that take a handle skip
+// hashing and probing entirely. When the file is reloaded or its table grows,
+// the handle notices the generation change and resolves itself again, so it
+// stays valid for the lifetime of the file. The key string is not copied and
+// must outlive the handle.
+typedef struct {
+    const char* key;
+    uint32_t slot;
+    uint32_t generation;
+} vars_handle;
+
+typedef enum {
+    VARS_KEY_ADDED,
+    VARS_KEY_CHANGED,
+    VARS_KEY_REMOVED
+} vars_change;
+
+// Called from vars_hot_load() for every key that was added, changed or removed,
+// after the file has been updated. key is the qualified key, e.g. "game/speed".
+typedef void (*vars_change_callback)(vars_file* file, const char* key, vars_change change, void* user_data);
+
+// Watches loaded files for changes. See vars_watch_poll().
+typedef struct vars_watcher vars_watcher;
+
+// A file shared between threads, with readers that never block on reloads.
+// See vars_shared_create().
+typedef struct vars_shared vars_shared;
+typedef struct vars_reader vars_reader;
+
+// Files layered on top of each other, with one merged table. See vars_stack_create().
+typedef struct vars_stack vars_stack;
+
+// Filled in by vars_get_stats(). Sizes are in bytes, times in seconds.
+typedef struct {
+    size_t entries;
+    size_t sections;
+    size_t capacity;       // Slots in the table. Compiled files have one per entry.
+    size_t tombstones;     // Slots of removed keys, reclaimed on the next rehash.
+    float load_factor;     // (entries + tombstones) / capacity. The table grows past 0.75.
+    float average_probe;   // Groups of 16 slots a lookup of a present key looks at.
+    size_t max_probe;
+    size_t file_bytes;     // The file buffer, heap or mapped.
+    size_t table_bytes;    // Control bytes, slots and the section list.
+    size_t key_bytes;      // Key and section names, whether in the file or owned.
+    size_t value_bytes;
+    size_t owned_bytes;    // Pool blocks and large strings holding values from vars_set_*().
+    double parse_seconds;  // Building the table at load. 0 for compiled files.
+    double reload_seconds; // The last vars_hot_load() that reloaded.
+    uint64_t lookups;      // Gets by key or handle. Only counted with VARS_ENABLE_STATS.
+    uint64_t misses;       // Gets that found nothing. Only counted with VARS_ENABLE_STATS.
+} vars_stats;
+
+// Called by vars_parse_stream() for every entry, in file order. None of the
+// strings are null-terminated, and they are only valid during the call. The
+// global section has length 0. Return 0 to stop parsing.
+typedef int (*vars_entry_callback)(const char* section, size_t section_len, const char* key, size_t key_len,
+                                   const char* value, size_t value_len, void* user_data);
+
+// Reads up to size bytes into buffer for vars_parse_reader(). Returns how many
+// it read, 0 at the end of the input or VARS_READ_ERROR.
+typedef size_t (*vars_read_callback)(void* context, char* buffer, size_t size);
+#define VARS_READ_ERROR ((size_t)-1)
+
+// A walk over a section, or over the keys matching a pattern. See
+// vars_section_iter() and vars_query(). The strings point into the file, aren't
+// null-terminated and stay valid until the file is changed or freed.
+typedef struct {
+    const char* section;
+    size_t section_len;
+    const char* key;
+    size_t key_len;
+    const char* value;
+    size_t value_len;
+
+    // Private
+    vars_file* file;
+    const char* section_pattern;
+    size_t section_pattern_len;
+    const char* key_pattern;
+    size_t key_pattern_len;
+    int section_glob;
+    int key_mode;
+    uint32_t next_rank;
+    uint32_t last_rank;
+    uint32_t position;
+    uint32_t end;
+    uint32_t generation;
+} vars_iter;
+
+// What vars_get_many() reads each key as.
+typedef enum {
+    VARS_GET_STRING,
+    VARS_GET_FLOAT,
+    VARS_GET_INT,
+    VARS_GET_BOOL,
+    VARS_GET_VEC2,
+    VARS_GET_VEC3,
+    VARS_GET_VEC4
+} vars_get_type;
+
+// One result of vars_get_many(), in the member matching its vars_get_type.
+// For VARS_GET_STRING, point string at a buffer before the call, as for
+// vars_get_string(). It is set to NULL if there's no string to copy.
+typedef union {
+    char* string;
+    float f;
+    int i;
+    int b;
+    vars_vec2 vec2;
+    vars_vec3 vec3;
+    vars_vec4 vec4;
+} vars_result;
+
 #ifdef VARS_DO_NOT_PREFIX_TYPES
 typedef vars_vec2 vec2;
 typedef vars_vec3 vec3;
@@ -38,7 +159,41 @@ extern "C" {
 #endif
 
 VARSAPI vars_file vars_load(const char* file_path);
+VARSAPI vars_file vars_load_mmap(const char* file_path);
+VARSAPI vars_file vars_load_binary(const char* file_path);
+VARSAPI vars_file vars_load_memory(const char* buffer, size_t len, int flags);
+VARSAPI int vars_compile(const char* src, const char* dst);
 VARSAPI int vars_hot_load(vars_file* file);
+VARSAPI int vars_on_change(vars_file* file, const char* filter, vars_change_callback callback, void* user_data);
+
+VARSAPI vars_watcher* vars_watch_create(void);
+VARSAPI int vars_watch_add(vars_watcher* watcher, vars_file* file);
+VARSAPI int vars_watch_remove(vars_watcher* watcher, vars_file* file);
+VARSAPI size_t vars_watch_poll(vars_watcher* watcher, vars_file** changed, size_t max);
+VARSAPI void vars_watch_free(vars_watcher* watcher);
+
+VARSAPI vars_shared* vars_shared_create(vars_file file);
+VARSAPI int vars_shared_reload(vars_shared* shared);
+VARSAPI vars_reader* vars_shared_reader(vars_shared* shared);
+VARSAPI void vars_reader_free(vars_reader* reader);
+VARSAPI vars_file* vars_read_begin(vars_reader* reader);
+VARSAPI void vars_read_end(vars_reader* reader);
+VARSAPI void vars_shared_free(vars_shared* shared);
+
+VARSAPI vars_stack* vars_stack_create(vars_file* layers, size_t count);
+VARSAPI vars_file* vars_stack_file(vars_stack* stack);
+VARSAPI int vars_stack_hot_load(vars_stack* stack);
+VARSAPI void vars_stack_free(vars_stack* stack);
+
+// Frees the cached copies of included files that no loaded file uses.
+VARSAPI size_t vars_include_cache_clear(void);
+
+VARSAPI int vars_parse_stream(FILE* stream, vars_entry_callback on_entry, void* user_data);
+VARSAPI int vars_parse_reader(vars_read_callback read, void* context, vars_entry_callback on_entry, void* user_data);
+
+VARSAPI vars_iter vars_section_iter(vars_file* file, const char* section);
+VARSAPI vars_iter vars_query(vars_file* file, const char* pattern);
+VARSAPI int vars_iter_next(vars_iter* iter);
 
 VARSAPI char* vars_get_string(char* key, vars_file* file, char* buffer);
 VARSAPI float vars_get_float(char* key, vars_file* file);
@@ -47,6 +202,16 @@ VARSAPI int vars_get_bool(char* key, vars_file* file);
 VARSAPI vars_vec2 vars_get_vec2(char* key, vars_file* file);
 VARSAPI vars_vec3 vars_get_vec3(char* key, vars_file* file);
 VARSAPI vars_vec4 vars_get_vec4(char* key, vars_file* file);
+VARSAPI size_t vars_get_many(vars_file* file, const char* const* keys, const vars_get_type* types, vars_result* out, size_t count);
+
+VARSAPI vars_handle vars_resolve(const char* key, vars_file* file);
+VARSAPI char* vars_get_string_h(vars_handle* handle, vars_file* file, char* buffer);
+VARSAPI float vars_get_float_h(vars_handle* handle, vars_file* file);
+VARSAPI int vars_get_int_h(vars_handle* handle, vars_file* file);
+VARSAPI int vars_get_bool_h(vars_handle* handle, vars_file* file);
+VARSAPI vars_vec2 vars_get_vec2_h(vars_handle* handle, vars_file* file);
+VARSAPI vars_vec3 vars_get_vec3_h(vars_handle* handle, vars_file* file);
+VARSAPI vars_vec4 vars_get_vec4_h(vars_handle* handle, vars_file* file);
 
 VARSAPI int vars_set_string(char* key, const char* value, vars_file* file);
 VARSAPI int vars_set_float(char* key, float value, vars_file* file);
@@ -57,6 +222,15 @@ VARSAPI int vars_set_vec3(char* key, vars_vec3 value, vars_file* file);
 VARSAPI int vars_set_vec4(char* key, vars_vec4 value, vars_file* file);
 
 VARSAPI int vars_save(vars_file* file);
+VARSAPI char* vars_save_to_memory(vars_file* file, size_t* out_len);
+VARSAPI void vars_free_memory(void* memory);
+VARSAPI int vars_write_file(const char* file_path, const char* data, size_t len);
+
+// Appends every set to "<file>.journal" so small changes are durable without
+// rewriting the file. Loads replay the journal and vars_save() empties it.
+VARSAPI int vars_journal_open(vars_file* file, size_t compact_size);
+
+VARSAPI int vars_get_stats(vars_file* file, vars_stats* stats);
 
 VARSAPI int vars_free(vars_file file);
 
@@ -74,6 +248,35 @@ VARSAPI int vars_free(vars_file file);
 #endif
 
 #include <ctype.h>
+#include <errno.h>
+#include <time.h>
+#include <locale.h>
+
+// Define all three before including the implementation to route every
+// allocation through your own allocator.
+#ifndef VARS_MALLOC
+#define VARS_MALLOC(size) malloc(size)
+#define VARS_REALLOC(ptr, size) realloc(ptr, size)
+#define VARS_FREE(ptr) free(ptr)
+#endif
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__) && !defined(VARS_NO_INOTIFY)
+#define VARS_USE_INOTIFY
+#include <sys/inotify.h>
+#endif
 
 #define IS_CAPITAL_LETTER(ch)  (((ch) >= 'A') && ((ch) <= 'Z'))
 #define IS_LOWER_CASE_LETTER(ch)  (((ch) >= 'a') && ((ch) <= 'z'))
@@ -87,451 +290,3650 @@ VARSAPI int vars_free(vars_file file);
 #define IS_DOUBLEQUOTES(ch) ((ch) == '"')
 #define IS_PAREN(ch) (((ch) == '(')  || ((ch) == ')'))
 
-// ---------------------------------------------
-// HASHMAP IMPLEMENTATION
-// ---------------------------------------------
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VARS_USE_SSE2
+#include <emmintrin.h>
+#endif
 
-typedef struct {
-    const char* key;
-    const char* value;
-} vars_kv_pair;
+#if defined(__AVX2__)
+#define VARS_USE_AVX2
+#include <immintrin.h>
+#endif
 
-typedef struct vars_map {
-    vars_kv_pair* entries;
-    size_t count;
-    size_t capacity;
-} vars_map;
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
 
-static uint32_t hash_fnv1a(const char* key) {
-    uint32_t hash = 2166136261u;
-    while (*key) {
-        hash ^= (uint8_t)(*key++);
-        hash *= 16777619u;
-    }
-    return hash;
+static int vars__ctz(uint32_t bits) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, bits);
+    return (int)index;
+#else
+    return __builtin_ctz(bits);
+#endif
 }
 
-static int vars_map_init(vars_map* map, size_t capacity) {
-    map->entries = (vars_kv_pair*)calloc(capacity, sizeof(vars_kv_pair));
-    map->count = 0;
-    map->capacity = capacity;
-    return map->entries != NULL;
+// A hint to start loading the cache line at address. It never faults.
+#if defined(__GNUC__) || defined(__clang__)
+#define VARS_PREFETCH(address) __builtin_prefetch(address)
+#elif defined(VARS_USE_SSE2)
+#define VARS_PREFETCH(address) _mm_prefetch((const char*)(address), _MM_HINT_T0)
+#else
+#define VARS_PREFETCH(address) ((void)(address))
+#endif
+
+static int vars__popcount(uint32_t bits) {
+#if defined(_MSC_VER)
+    return (int)__popcnt(bits);
+#else
+    return __builtin_popcount(bits);
+#endif
 }
 
-static void vars_map_insert(vars_map* map, const char* key, const char* value) {
-    uint32_t hash = hash_fnv1a(key);
-    size_t idx = hash % map->capacity;
+// ---------------------------------------------
+// SCANNING
+// ---------------------------------------------
 
-    for (size_t i = 0; i < map->capacity; i++) {
-        size_t probe = (idx + i) % map->capacity;
-        if (map->entries[probe].key == NULL) {
-            map->entries[probe].key = key;
-            map->entries[probe].value = value;
-            map->count++;
-            return;
-        }
+// The parser spends most of its time looking for the end of a line, a comment
+// or a string. These scanners compare 32 (AVX2) or 16 (SSE2) bytes at a time
+// and turn the matches into a bitmask, so the next boundary is one ctz away.
+// Short tokens like keys are still walked byte by byte.
+
+// Returns the first byte in [cursor, end) equal to a, b or c, or end.
+static const char* vars__scan3(const char* cursor, const char* end, char a, char b, char c) {
+#ifdef VARS_USE_AVX2
+    const __m256i wide_a = _mm256_set1_epi8(a);
+    const __m256i wide_b = _mm256_set1_epi8(b);
+    const __m256i wide_c = _mm256_set1_epi8(c);
+    while (end - cursor >= 32) {
+        __m256i block = _mm256_loadu_si256((const __m256i*)cursor);
+        __m256i hits = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(block, wide_a), _mm256_cmpeq_epi8(block, wide_b)),
+                                       _mm256_cmpeq_epi8(block, wide_c));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(hits);
+        if (mask) return cursor + vars__ctz(mask);
+        cursor += 32;
     }
+#endif
+#ifdef VARS_USE_SSE2
+    const __m128i narrow_a = _mm_set1_epi8(a);
+    const __m128i narrow_b = _mm_set1_epi8(b);
+    const __m128i narrow_c = _mm_set1_epi8(c);
+    while (end - cursor >= 16) {
+        __m128i block = _mm_loadu_si128((const __m128i*)cursor);
+        __m128i hits = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(block, narrow_a), _mm_cmpeq_epi8(block, narrow_b)),
+                                    _mm_cmpeq_epi8(block, narrow_c));
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(hits);
+        if (mask) return cursor + vars__ctz(mask);
+        cursor += 16;
+    }
+#endif
+    while (cursor < end && *cursor != a && *cursor != b && *cursor != c) cursor++;
+    return cursor;
 }
 
-static const char* vars_map_get(vars_map* map, const char* key) {
-    uint32_t hash = hash_fnv1a(key);
-    size_t idx = hash % map->capacity;
+static const char* vars__find_end_of_line(const char* cursor, const char* end) {
+    return vars__scan3(cursor, end, '\n', '\r', '\r');
+}
 
-    for (size_t i = 0; i < map->capacity; i++) {
-        size_t probe = (idx + i) % map->capacity;
-        if (map->entries[probe].key == NULL) return NULL;
-        if (strcmp(map->entries[probe].key, key) == 0) {
-            return map->entries[probe].value;
-        }
-    }
-    return NULL;
+static const char* vars__find_end_of_value(const char* cursor, const char* end) {
+    return vars__scan3(cursor, end, '\n', '\r', '#');
 }
 
-static void vars_map_free(vars_map* map) {
-    free(map->entries);
-    map->entries = NULL;
-    map->capacity = 0;
-    map->count = 0;
+static size_t vars__count_lines(const char* cursor, const char* end) {
+    size_t count = 0;
+#ifdef VARS_USE_AVX2
+    const __m256i wide_nl = _mm256_set1_epi8('\n');
+    while (end - cursor >= 32) {
+        __m256i block = _mm256_loadu_si256((const __m256i*)cursor);
+        count += (size_t)vars__popcount((uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, wide_nl)));
+        cursor += 32;
+    }
+#endif
+#ifdef VARS_USE_SSE2
+    const __m128i narrow_nl = _mm_set1_epi8('\n');
+    while (end - cursor >= 16) {
+        __m128i block = _mm_loadu_si128((const __m128i*)cursor);
+        count += (size_t)vars__popcount((uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(block, narrow_nl)));
+        cursor += 16;
+    }
+#endif
+    for (; cursor < end; cursor++) count += *cursor == '\n';
+    return count;
 }
 
 // ---------------------------------------------
-// HOT RELOAD SUPPORT
+// STATISTICS
 // ---------------------------------------------
 
-static long vars__get_file_mod_time(const char* file_path) {
-    struct stat st;
-    if (stat(file_path, &st) == 0) {
-        return (long)st.st_mtime;
-    }
-    return -1;
+// Timings and counters reported by vars_get_stats(). The counters cost an
+// increment per get, so they are only kept with VARS_ENABLE_STATS. They aren't
+// atomic, so readers of a vars_shared file may lose a few counts.
+typedef struct {
+    double parse_seconds;
+    double reload_seconds;
+#ifdef VARS_ENABLE_STATS
+    uint64_t lookups;
+    uint64_t misses;
+#endif
+} vars_usage;
+
+#ifdef VARS_ENABLE_STATS
+#define VARS_COUNT_LOOKUP(usage, found) do { (usage)->lookups++; if (!(found)) (usage)->misses++; } while (0)
+#else
+#define VARS_COUNT_LOOKUP(usage, found) ((void)0)
+#endif
+
+// A monotonic clock in seconds. Strict C99 builds on POSIX don't declare
+// clock_gettime(), and fall back to processor time.
+static double vars__now(void) {
+#ifdef _WIN32
+    LARGE_INTEGER frequency, counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart / (double)frequency.QuadPart;
+#elif defined(CLOCK_MONOTONIC)
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+#else
+    return (double)clock() / CLOCKS_PER_SEC;
+#endif
 }
 
-static vars_file vars__load_and_parse_file(const char* file_path) {
-    vars_file file = {0};
+// ---------------------------------------------
+// NUMBERS
+// ---------------------------------------------
 
-    FILE* fp = fopen(file_path, "rb");
-    if (!fp) {
-        fprintf(stderr, "ERROR: vars_load: Failed to open file: %s\n", file_path);
-        exit(EXIT_FAILURE);
+// Numbers are read and written here rather than with strtof, strtol and
+// printf. Those follow the C locale, so under one with a decimal comma
+// strtof stops at the '.' in "1.5", and "%.6f" both writes a comma and drops
+// digits. The results match strtof and strtol under the "C" locale.
+
+static const double vars__pow10[23] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// Longest text vars__format_float() writes, with the terminator. The
+// smallest floats need "-0." and 44 zeros before their digits.
+#define VARS_FLOAT_CHARS 64
+
+// mantissa * 10^exponent rounded to the nearest float, if that can be done
+// with one double operation. Both operands are exact doubles, so the double
+// result is the exact value correctly rounded, but rounding it again to float
+// is only right if it didn't land exactly halfway between two floats: the
+// exact value may have been just above or below that midpoint, and which one
+// is lost. Returns 0 for those and when the operands aren't exact.
+static int vars__float_fast_path(uint64_t mantissa, int exponent, float* out) {
+    if (mantissa > ((uint64_t)1 << 53) || exponent < -22 || exponent > 22) return 0;
+    double value = (double)mantissa;
+    value = exponent < 0 ? value / vars__pow10[-exponent] : value * vars__pow10[exponent];
+
+    // Every result is a normal float, between 1e-22 and 2^53 * 1e22, so the
+    // 29 low bits of the double's 52 are the ones the float drops. A midpoint
+    // has the top one of them set and the rest clear.
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    if ((bits & 0x1FFFFFFFu) == 0x10000000u) return 0;
+    *out = (float)value;
+    return 1;
+}
+
+// strtof for what the fast path can't round exactly, like long mantissas,
+// far exponents, hex, inf and nan. strtof wants the locale's decimal point,
+// so when that isn't '.' it reads a copy with the '.' swapped.
+static float vars__strtof_c(const char* text, const char** end) {
+    const char* point = localeconv()->decimal_point;
+    char* float_end;
+    if (!point || (point[0] == '.' && point[1] == '\0')) {
+        float value = strtof(text, &float_end);
+        *end = float_end;
+        return value;
     }
-    
-    fseek(fp, 0, SEEK_END);
-    long size = ftell(fp);
-    rewind(fp);
-    
-    if (size <= 0) {
-        fprintf(stderr, "ERROR: vars_load: Invalid file size.\n");
-        fclose(fp);
-        exit(EXIT_FAILURE);
+
+    // Only the characters a float can be made of are copied.
+    size_t point_len = strlen(point);
+    size_t len = 0, copy_len = 1;
+    while (isalnum((unsigned char)text[len]) || text[len] == '.' || text[len] == '+' || text[len] == '-') {
+        copy_len += text[len] == '.' ? point_len : 1;
+        len++;
     }
-    
-    file.filebuf = (char*)malloc(size);
-    file.parsed_buf = (char*)malloc(size);
-    if (!file.filebuf || !file.parsed_buf) {
-        fprintf(stderr, "ERROR: vars_load: Memory allocation failed.\n");
-        fclose(fp);
-        exit(EXIT_FAILURE);
+    char local[128];
+    char* copy = copy_len <= sizeof(local) ? local : (char*)VARS_MALLOC(copy_len);
+    if (!copy) {
+        *end = text;
+        return 0.0f;
     }
-    
-    size_t read = fread(file.filebuf, 1, size, fp);
-    fclose(fp);
-    
-    if (read != (size_t)size) {
-        fprintf(stderr, "ERROR: vars_load: File read incomplete (%zu of %ld bytes).\n", read, size);
-        free(file.filebuf);
-        free(file.parsed_buf);
-        exit(EXIT_FAILURE);
+    char* cursor = copy;
+    for (size_t i = 0; i < len; i++) {
+        if (text[i] == '.') {
+            memcpy(cursor, point, point_len);
+            cursor += point_len;
+        } else {
+            *cursor++ = text[i];
+        }
     }
+    *cursor = '\0';
 
-    char* cursor = file.filebuf;
-    char* end = file.filebuf + size;
-    char* dst = file.parsed_buf;
-    file.map = (vars_map*)malloc(sizeof(vars_map));
-    vars_map_init(file.map, 128);
+    float value = strtof(copy, &float_end);
+    size_t consumed = 0, copied = 0;
+    while (copied < (size_t)(float_end - copy)) copied += text[consumed++] == '.' ? point_len : 1;
+    *end = text + consumed;
+    if (copy != local) VARS_FREE(copy);
+    return value;
+}
 
-    char section[256] = "";
+// Reads a float like strtof does. *end is where it stopped, or text when
+// there was no number.
+static float vars__parse_float(const char* text, const char** end) {
+    const char* cursor = text;
+    while (IS_WHITE_SPACE(*cursor) || IS_END_OF_LINE(*cursor)) cursor++;
+    const char* number = cursor;
+    int negative = *cursor == '-';
+    if (*cursor == '+' || *cursor == '-') cursor++;
 
-    while (cursor < end) {
-        while (cursor < end && IS_WHITE_SPACE(*cursor)) cursor++;
-        if (cursor >= end) break;
-        
-        if (*cursor == '#') {
-            while (cursor < end && !IS_END_OF_LINE(*cursor)) cursor++;
-            while (cursor < end && IS_END_OF_LINE(*cursor)) cursor++;
-            continue;
+    // Up to 19 significant digits fit in the mantissa. Zeros after them are
+    // counted in the exponent, anything else needs the slow path.
+    uint64_t mantissa = 0;
+    int digits = 0, exponent = 0, exact = 1;
+    const char* first = cursor;
+    for (; IS_NUMBER(*cursor); cursor++) {
+        if (digits < 19) {
+            mantissa = mantissa * 10 + (uint64_t)(*cursor - '0');
+            digits += mantissa != 0;
+        } else {
+            exponent++;
+            exact &= *cursor == '0';
         }
-
-        if (*cursor == ':' && cursor + 1 < end && cursor[1] == '/') {
-            cursor += 2;
-            size_t i = 0;
-            while (cursor < end && !IS_WHITE_SPACE(*cursor) && !IS_END_OF_LINE(*cursor) && i < sizeof(section) - 1) {
-                section[i++] = *cursor++;
+    }
+    size_t whole_digits = (size_t)(cursor - first);
+    size_t fraction_digits = 0;
+    if (*cursor == '.') {
+        const char* fraction = ++cursor;
+        for (; IS_NUMBER(*cursor); cursor++) {
+            if (digits < 19) {
+                mantissa = mantissa * 10 + (uint64_t)(*cursor - '0');
+                digits += mantissa != 0;
+                exponent--;
+            } else {
+                exact &= *cursor == '0';
             }
-            section[i] = '\0';
-            while (cursor < end && IS_END_OF_LINE(*cursor)) cursor++;
-            continue;
         }
+        fraction_digits = (size_t)(cursor - fraction);
+    }
 
-        // Skip empty lines
-        if (IS_END_OF_LINE(*cursor)) {
-            while (cursor < end && IS_END_OF_LINE(*cursor)) cursor++;
-            continue;
-        }
+    // No digits means inf, nan or no number at all, and "0x" is hex.
+    if (whole_digits + fraction_digits == 0 || (first[0] == '0' && (first[1] == 'x' || first[1] == 'X'))) {
+        const char* float_end;
+        float value = vars__strtof_c(number, &float_end);
+        *end = float_end == number ? text : float_end;
+        return value;
+    }
 
-        char* key = dst;
-        while (cursor < end && (IS_LETTER(*cursor) || IS_NUMBER(*cursor) || IS_UNDERSCORE(*cursor))) {
-            *dst++ = *cursor++;
-        }
-        
-        if (key == dst) {
-            // No key found, skip this line
-            while (cursor < end && !IS_END_OF_LINE(*cursor)) cursor++;
-            while (cursor < end && IS_END_OF_LINE(*cursor)) cursor++;
-            continue;
+    if (*cursor == 'e' || *cursor == 'E') {
+        const char* digit = cursor + 1;
+        int exponent_negative = *digit == '-';
+        if (*digit == '+' || *digit == '-') digit++;
+        if (IS_NUMBER(*digit)) {
+            int written = 0;
+            for (; IS_NUMBER(*digit); digit++) {
+                if (written < 100000) written = written * 10 + (*digit - '0');
+            }
+            exponent += exponent_negative ? -written : written;
+            cursor = digit;
         }
-        
-        *dst++ = '\0';
-
-        while (cursor < end && IS_WHITE_SPACE(*cursor)) cursor++;
+    }
+    *end = cursor;
 
-        char* value = dst;
-        if (cursor < end && *cursor == '"') {
-            *dst++ = *cursor++;
-            while (cursor < end && *cursor != '"') *dst++ = *cursor++;
-            if (cursor < end && *cursor == '"') *dst++ = *cursor++;
-        } else {
-            while (cursor < end && !IS_END_OF_LINE(*cursor) && *cursor != '#') *dst++ = *cursor++;
-            // Trim trailing whitespace
-            while (dst > value && IS_WHITE_SPACE(*(dst-1))) dst--;
-        }
-        *dst++ = '\0';
+    float value;
+    if (mantissa == 0) {
+        value = 0.0f;
+    } else if (!exact || !vars__float_fast_path(mantissa, exponent, &value)) {
+        const char* float_end;
+        return vars__strtof_c(number, &float_end);
+    }
+    return negative ? -value : value;
+}
 
-        char qualified_key[512];
-        if (section[0]) {
-            snprintf(qualified_key, sizeof(qualified_key), "%s/%s", section, key);
-        } else {
-            snprintf(qualified_key, sizeof(qualified_key), "%s", key);
-        }
+// Reads a base 10 integer like strtol does, saturating at LONG_MIN and
+// LONG_MAX. *end is where it stopped, or text when there was no number.
+static long vars__parse_long(const char* text, const char** end) {
+    const char* cursor = text;
+    while (IS_WHITE_SPACE(*cursor) || IS_END_OF_LINE(*cursor)) cursor++;
+    int negative = *cursor == '-';
+    if (*cursor == '+' || *cursor == '-') cursor++;
+    if (!IS_NUMBER(*cursor)) {
+        *end = text;
+        return 0;
+    }
 
-        vars_map_insert(file.map, strdup(qualified_key), value);
-        while (cursor < end && IS_END_OF_LINE(*cursor)) cursor++;
+    unsigned long limit = negative ? (unsigned long)LONG_MAX + 1 : (unsigned long)LONG_MAX;
+    unsigned long value = 0;
+    int overflow = 0;
+    for (; IS_NUMBER(*cursor); cursor++) {
+        unsigned long digit = (unsigned long)(*cursor - '0');
+        if (value > (limit - digit) / 10) overflow = 1;
+        else value = value * 10 + digit;
     }
+    *end = cursor;
 
-    file.parsed_len = (size_t)(dst - file.parsed_buf);
-    return file;
+    if (overflow) return negative ? LONG_MIN : LONG_MAX;
+    if (!negative) return (long)value;
+    return value > (unsigned long)LONG_MAX ? LONG_MIN : -(long)value;
 }
 
-// ---------------------------------------------
-// HELPER FUNCTIONS
-// ---------------------------------------------
+// Writes digits with the decimal point after the first point of them, padding
+// with zeros on either side, so the text never needs an exponent. There is
+// always a '.', so the value still reads back as a float.
+static char* vars__write_decimal(char* out, const char* digits, int count, int point) {
+    if (point <= 0) {
+        *out++ = '0';
+        *out++ = '.';
+        for (int i = point; i < 0; i++) *out++ = '0';
+        memcpy(out, digits, (size_t)count);
+        return out + count;
+    }
+    if (point >= count) {
+        memcpy(out, digits, (size_t)count);
+        out += count;
+        for (int i = count; i < point; i++) *out++ = '0';
+        *out++ = '.';
+        *out++ = '0';
+        return out;
+    }
+    memcpy(out, digits, (size_t)point);
+    out += point;
+    *out++ = '.';
+    memcpy(out, digits + point, (size_t)(count - point));
+    return out + count - point;
+}
 
-static const char* find_key_value(char* key, vars_file* file) {
-    if (!file->map) return NULL;
-    return vars_map_get(file->map, key);
+// Writes the shortest decimal that reads back as exactly value, e.g. "0.1"
+// rather than "0.100000", and returns its length. out needs VARS_FLOAT_CHARS.
+static int vars__format_float(float value, char* out) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    char* cursor = out;
+    if (bits >> 31) *cursor++ = '-';
+    bits &= 0x7FFFFFFFu;
+    if (bits >= 0x7F800000u) {
+        memcpy(cursor, bits == 0x7F800000u ? "inf" : "nan", 4);
+        return (int)(cursor - out) + 3;
+    }
+    float magnitude;
+    memcpy(&magnitude, &bits, sizeof(magnitude));
+    double d = (double)magnitude;
+
+    char digits[24];
+    int count = 0, point = 0;
+    if (bits == 0) {
+        digits[count++] = '0';
+        point = 1;
+    } else {
+        // Scale so that p digits are left of the point, round, and check the
+        // nearest integers, for p = 1, 2, ... The check is an exact fast path
+        // parse, so the first hit is the shortest text that reads back.
+        int e10 = 0;
+        while (e10 < 22 && d >= vars__pow10[e10 + 1]) e10++;
+        if (d < 1.0) {
+            while (e10 > -22 && d * vars__pow10[-e10] < 1.0) e10--;
+        }
+        uint64_t found = 0;
+        int found_exponent = 0, hit = 0;
+        int in_range = d >= 1e-22 && d < 1e22;
+        for (int p = 1; p <= 9 && in_range && !hit; p++) {
+            int k = p - 1 - e10;
+            if (k > 22 || k < -22) break;
+            double scaled = k >= 0 ? d * vars__pow10[k] : d / vars__pow10[-k];
+            uint64_t nearest = (uint64_t)(scaled + 0.5);
+            uint64_t candidates[3] = { nearest, nearest + 1, nearest - 1 };
+            for (int c = 0; c < 3 && !hit; c++) {
+                float back;
+                if (candidates[c] == 0 || candidates[c] > nearest + 1) continue;
+                if (vars__float_fast_path(candidates[c], -k, &back) && back == magnitude) {
+                    found = candidates[c];
+                    found_exponent = -k;
+                    hit = 1;
+                }
+            }
+        }
+
+        if (hit) {
+            while (found % 10 == 0) {
+                found /= 10;
+                found_exponent++;
+            }
+            char reversed[24];
+            while (found) {
+                reversed[count++] = (char)('0' + found % 10);
+                found /= 10;
+            }
+            for (int i = 0; i < count; i++) digits[i] = reversed[count - 1 - i];
+            point = count + found_exponent;
+        } else {
+            // Floats past 1e22 or near the bottom of the range: take the
+            // shortest precision of "%e" that reads back. It is exact but slow.
+            for (int p = 1; p <= 9; p++) {
+                char scientific[40];
+                char decimal[VARS_FLOAT_CHARS];
+                snprintf(scientific, sizeof(scientific), "%.*e", p - 1, d);
+                count = 0;
+                const char* s = scientific;
+                for (; *s && *s != 'e'; s++) {
+                    if (IS_NUMBER(*s)) digits[count++] = *s;
+                }
+                const char* exponent_end;
+                point = (int)vars__parse_long(s + 1, &exponent_end) + 1;
+                *vars__write_decimal(decimal, digits, count, point) = '\0';
+                const char* end;
+                if (vars__parse_float(decimal, &end) == magnitude) break;
+            }
+            while (count > 1 && digits[count - 1] == '0') count--;
+        }
+    }
+
+    cursor = vars__write_decimal(cursor, digits, count, point);
+    *cursor = '\0';
+    return (int)(cursor - out);
 }
 
-static int parse_vec(const char* val, float* out, int count) {
-    if (*val != '(') return 0;
-    val++;
+// Writes "(x y ...)" for count components into out, which needs room for
+// count * VARS_FLOAT_CHARS + 2 bytes.
+static void vars__format_vec(const float* values, int count, char* out) {
+    *out++ = '(';
     for (int i = 0; i < count; i++) {
-        while (*val && IS_WHITE_SPACE(*val)) val++;
-        char* end;
-        out[i] = strtof(val, &end);
-        if (val == end) return 0;
-        val = end;
+        if (i) *out++ = ' ';
+        out += vars__format_float(values[i], out);
     }
-    while (*val && IS_WHITE_SPACE(*val)) val++;
-    return *val == ')';
+    *out++ = ')';
+    *out = '\0';
 }
 
 // ---------------------------------------------
-// SAVE FUNCTIONS
+// HASHMAP IMPLEMENTATION
 // ---------------------------------------------
 
+// Open addressing with one control byte per slot, in the style of SwissTable.
+// A control byte is VARS_CTRL_EMPTY, VARS_CTRL_DELETED or the top 7 bits of
+// the key's hash. Deleted slots keep probe sequences going until the next rehash.
+// Lookups compare a whole group of control bytes at once, and only slots whose
+// tag matches are looked at in the entry array, so a probe usually touches a
+// single 16 byte line of metadata before any key is compared.
+
+#define VARS_GROUP_SIZE 16
+#define VARS_CTRL_EMPTY 0x80
+#define VARS_CTRL_DELETED 0xFE
+#define VARS_CTRL_IS_FULL(ctrl) ((ctrl) < 0x80)
+#define VARS_HASH_TAG(hash) ((uint8_t)((hash) >> 25))
+
+typedef enum {
+    VARS_TYPE_TEXT,   // Anything else. The numeric fields still hold what was read of it as numbers.
+    VARS_TYPE_STRING,
+    VARS_TYPE_INT,
+    VARS_TYPE_FLOAT,
+    VARS_TYPE_BOOL,
+    VARS_TYPE_VEC
+} vars_type;
+
+// Every value is converted once, when it is loaded or set, into whatever each
+// getter would have parsed out of its text. Getters only load from here.
+typedef struct {
+    float f[4];      // The text read as a float, or the components of a vector
+    int i;           // The text read as an integer
+    uint8_t type;    // vars_type
+    uint8_t count;   // vector components that parsed
+    uint8_t is_true;
+} vars_value;
+
+// Keys and values are (pointer, length) views. Normally they point straight
+// into the file buffer, which may be a read-only mapping, so nothing is copied
+// at load. Only keys and values created by vars_set_* are heap allocated, and
+// the flags record which ones the pair owns. Keys that came from an
+// ":include" point into the included file instead, and aren't saved.
+#define VARS_PAIR_OWNS_KEY   0x1
+#define VARS_PAIR_OWNS_VALUE 0x2
+#define VARS_PAIR_INCLUDED   0x8
+
 typedef struct {
-    char* section;
-    char* key;
-    char* value;
-} vars_entry;
+    uint32_t hash;      // Hash of the qualified "section/key" name.
+    uint16_t key_len;
+    uint16_t flags;     // VARS_PAIR_OWNS_* and VARS_PAIR_INCLUDED
+    uint32_t value_len;
+    uint32_t section;   // Index into vars_map.sections. 0 is the global section.
+    const char* key;
+    const char* value;
+    vars_value typed;
+} vars_kv_pair;
 
+// Keys only hold their own name, and the section they were declared under is
+// stored once here. The hash of "name/" is kept so hashing a qualified key
+// while parsing only has to continue over the key itself.
 typedef struct {
-    vars_entry* entries;
-    size_t count;
-    size_t capacity;
-} vars_entry_list;
+    const char* name;
+    uint32_t len;
+    uint32_t hash;
+    int owned;
+} vars_section;
 
-static void vars_entry_list_init(vars_entry_list* list) {
-    list->entries = NULL;
-    list->count = 0;
-    list->capacity = 0;
-}
+#define VARS_FNV_OFFSET 2166136261u
+#define VARS_FNV_PRIME 16777619u
 
-static void vars_entry_list_add(vars_entry_list* list, const char* section, const char* key, const char* value) {
-    if (list->count >= list->capacity) {
-        list->capacity = list->capacity ? list->capacity * 2 : 16;
-        list->entries = (vars_entry*)realloc(list->entries, list->capacity * sizeof(vars_entry));
+static uint32_t hash_fnv1a(uint32_t hash, const char* data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (uint8_t)data[i];
+        hash *= VARS_FNV_PRIME;
     }
-    
-    vars_entry* entry = &list->entries[list->count++];
-    entry->section = section ? strdup(section) : NULL;
-    entry->key = strdup(key);
-    entry->value = strdup(value);
+    return hash;
 }
 
-static void vars_entry_list_free(vars_entry_list* list) {
-    for (size_t i = 0; i < list->count; i++) {
-        free(list->entries[i].section);
-        free(list->entries[i].key);
-        free(list->entries[i].value);
-    }
-    free(list->entries);
-    list->entries = NULL;
-    list->count = 0;
-    list->capacity = 0;
+static void* vars__calloc(size_t count, size_t size) {
+    void* memory = VARS_MALLOC(count * size);
+    if (memory) memset(memory, 0, count * size);
+    return memory;
 }
 
-static int vars_entry_compare(const void* a, const void* b) {
-    const vars_entry* ea = (const vars_entry*)a;
-    const vars_entry* eb = (const vars_entry*)b;
-    
-    // Sort by section first (NULL sections come first)
-    if (!ea->section && !eb->section) return strcmp(ea->key, eb->key);
-    if (!ea->section) return -1;
-    if (!eb->section) return 1;
-    
-    int section_cmp = strcmp(ea->section, eb->section);
-    if (section_cmp != 0) return section_cmp;
-    
-    return strcmp(ea->key, eb->key);
+static char* vars__strndup(const char* str, size_t len) {
+    char* copy = (char*)VARS_MALLOC(len + 1);
+    if (!copy) return NULL;
+    memcpy(copy, str, len);
+    copy[len] = '\0';
+    return copy;
 }
 
-static int vars__set_value(char* key, const char* value, vars_file* file) {
-    if (!file || !file->map) return 0;
-    
-    // Check if key already exists in hashmap
-    const char* existing = vars_map_get(file->map, key);
-    if (existing) {
-        // Key exists, update the value in the hashmap
-        // We need to update the parsed_buf entry that corresponds to this key
-        
-        // Find the entry in the hashmap and replace it
-        uint32_t hash = hash_fnv1a(key);
-        size_t idx = hash % file->map->capacity;
-        
-        for (size_t i = 0; i < file->map->capacity; i++) {
-            size_t probe = (idx + i) % file->map->capacity;
-            if (file->map->entries[probe].key && strcmp(file->map->entries[probe].key, key) == 0) {
-                // Found the entry, update the value
-                file->map->entries[probe].value = strdup(value);
-                return 1;
-            }
-        }
-    } else {
-        // Key doesn't exist, add it
-        vars_map_insert(file->map, strdup(key), strdup(value));
+// ---------------------------------------------
+// STRING POOL
+// ---------------------------------------------
+
+// Keys, values and section names the map owns (everything vars_set_* adds)
+// come from a per-file pool instead of one malloc each. Strings are rounded up
+// to a size class and carved out of large blocks; freed ones go on a free
+// list for their class, so a value that is set every frame keeps reusing the
+// same few bytes. Strings too big for any class use VARS_MALLOC directly.
+// The caller passes the string length back on free, so no headers are needed.
+
+#define VARS_POOL_BLOCK_SIZE 16384
+#define VARS_POOL_MIN_CLASS 16
+#define VARS_POOL_CLASS_COUNT 7 // 16 to 1024 bytes
+#define VARS_POOL_MAX_CLASS (VARS_POOL_MIN_CLASS << (VARS_POOL_CLASS_COUNT - 1))
+
+typedef struct vars_pool_block {
+    struct vars_pool_block* next;
+    void* align; // Keeps the data that follows 16 byte aligned.
+} vars_pool_block;
+
+typedef struct {
+    vars_pool_block* blocks;
+    char* cursor;
+    char* end;
+    void* free_lists[VARS_POOL_CLASS_COUNT];
+} vars_pool;
+
+static int vars_pool_class(size_t size) {
+    int index = 0;
+    size_t class_size = VARS_POOL_MIN_CLASS;
+    while (class_size < size) {
+        class_size <<= 1;
+        index++;
     }
-    
-    return 1;
+    return index;
 }
 
-VARSAPI int vars_set_string(char* key, const char* value, vars_file* file) {
-    if (!key || !value || !file) return 0;
-    
-    // Format as quoted string
-    size_t len = strlen(value);
-    char* quoted_value = (char*)malloc(len + 3); // +2 for quotes, +1 for null terminator
-    if (!quoted_value) return 0;
-    
-    quoted_value[0] = '"';
-    strcpy(quoted_value + 1, value);
-    quoted_value[len + 1] = '"';
-    quoted_value[len + 2] = '\0';
-    
-    int result = vars__set_value(key, quoted_value, file);
-    free(quoted_value);
-    return result;
-}
+static char* vars_pool_alloc(vars_pool* pool, size_t size) {
+    if (size > VARS_POOL_MAX_CLASS) return (char*)VARS_MALLOC(size);
 
-VARSAPI int vars_set_float(char* key, float value, vars_file* file) {
-    if (!key || !file) return 0;
-    
-    char buffer[32];
-    snprintf(buffer, sizeof(buffer), "%.6f", value);
-    return vars__set_value(key, buffer, file);
-}
+    int index = vars_pool_class(size);
+    if (pool->free_lists[index]) {
+        void* reused = pool->free_lists[index];
+        memcpy(&pool->free_lists[index], reused, sizeof(void*));
+        return (char*)reused;
+    }
 
-VARSAPI int vars_set_int(char* key, int value, vars_file* file) {
-    if (!key || !file) return 0;
-    
-    char buffer[32];
-    snprintf(buffer, sizeof(buffer), "%d", value);
-    return vars__set_value(key, buffer, file);
+    size_t class_size = (size_t)VARS_POOL_MIN_CLASS << index;
+    if (!pool->cursor || (size_t)(pool->end - pool->cursor) < class_size) {
+        vars_pool_block* block = (vars_pool_block*)VARS_MALLOC(sizeof(vars_pool_block) + VARS_POOL_BLOCK_SIZE);
+        if (!block) return NULL;
+        block->next = pool->blocks;
+        pool->blocks = block;
+        pool->cursor = (char*)(block + 1);
+        pool->end = pool->cursor + VARS_POOL_BLOCK_SIZE;
+    }
+    char* memory = pool->cursor;
+    pool->cursor += class_size;
+    return memory;
 }
 
-VARSAPI int vars_set_bool(char* key, int value, vars_file* file) {
-    if (!key || !file) return 0;
-    
-    return vars__set_value(key, value ? "true" : "false", file);
+static void vars_pool_free(vars_pool* pool, const char* memory, size_t size) {
+    if (size > VARS_POOL_MAX_CLASS) {
+        VARS_FREE((void*)memory);
+        return;
+    }
+    int index = vars_pool_class(size);
+    memcpy((void*)memory, &pool->free_lists[index], sizeof(void*));
+    pool->free_lists[index] = (void*)memory;
 }
 
-VARSAPI int vars_set_vec2(char* key, vars_vec2 value, vars_file* file) {
-    if (!key || !file) return 0;
-    
-    char buffer[64];
-    snprintf(buffer, sizeof(buffer), "(%.6f %.6f)", value.x, value.y);
-    return vars__set_value(key, buffer, file);
+static char* vars_pool_strndup(vars_pool* pool, const char* str, size_t len) {
+    char* copy = vars_pool_alloc(pool, len + 1);
+    if (!copy) return NULL;
+    memcpy(copy, str, len);
+    copy[len] = '\0';
+    return copy;
+}
+
+static void vars_pool_release(vars_pool* pool) {
+    while (pool->blocks) {
+        vars_pool_block* next = pool->blocks->next;
+        VARS_FREE(pool->blocks);
+        pool->blocks = next;
+    }
+    memset(pool, 0, sizeof(*pool));
+}
+
+static void vars__parse_value(const char* value, size_t len, vars_value* out) {
+    memset(out, 0, sizeof(*out));
+
+    if (len > 0 && *value == '"') {
+        out->type = VARS_TYPE_STRING;
+        return;
+    }
+
+    // The number parsers need a terminator, and views into the file don't have one.
+    char local[128];
+    char* text = len < sizeof(local) ? local : (char*)VARS_MALLOC(len + 1);
+    if (!text) return;
+    memcpy(text, value, len);
+    text[len] = '\0';
+
+    if (*text == '(') {
+        // Same walk as a vector getter: count how many components parse before
+        // the first thing that isn't a number.
+        const char* cursor = text + 1;
+        out->type = VARS_TYPE_VEC;
+        while (out->count < 4) {
+            while (*cursor && IS_WHITE_SPACE(*cursor)) cursor++;
+            const char* end;
+            float component = vars__parse_float(cursor, &end);
+            if (end == cursor) break;
+            out->f[out->count++] = component;
+            cursor = end;
+        }
+    } else if (strcmp(text, "true") == 0 || strcmp(text, "false") == 0) {
+        out->type = VARS_TYPE_BOOL;
+        out->is_true = text[0] == 't';
+    } else {
+        const char* int_end;
+        const char* float_end;
+        out->i = (int)vars__parse_long(text, &int_end);
+        out->f[0] = vars__parse_float(text, &float_end);
+        if (int_end != text && *int_end == '\0') {
+            out->type = VARS_TYPE_INT;
+        } else if (float_end != text && *float_end == '\0') {
+            out->type = VARS_TYPE_FLOAT;
+        } else {
+            out->type = VARS_TYPE_TEXT;
+        }
+    }
+
+    if (text != local) VARS_FREE(text);
+}
+
+// Slots in save order: by section name, then by key. A section's keys are
+// contiguous, so listing a section or matching a pattern doesn't walk the
+// table. Built on demand and kept while generation stays the same, so sets
+// that only change values keep it.
+typedef struct {
+    uint32_t* slots;
+    uint32_t* starts;    // The section ranked r owns slots[starts[r]] up to slots[starts[r + 1]].
+    uint32_t* sections;  // Section index for each rank.
+    uint32_t* ranks;     // Rank for each section index.
+    uint32_t generation; // The map generation it was built for, 0 before that.
+} vars_order;
+
+// The ":include" lines of a file, in file order. The paths are views into the
+// file buffer, as written, and include is the cached file each one loaded.
+typedef struct {
+    const char* path;
+    uint32_t len;
+    struct vars_include* include; // NULL for files loaded from memory.
+} vars_include_line;
+
+typedef struct {
+    vars_include_line* lines;
+    uint32_t count;
+    uint32_t capacity;
+} vars_include_list;
+
+typedef struct vars_map {
+    uint8_t* ctrl;
+    vars_kv_pair* entries;
+    size_t count;
+    size_t deleted;  // Tombstones. They use up slots until the next rehash.
+    size_t capacity; // Always a power of two and a multiple of VARS_GROUP_SIZE.
+    size_t mask;
+    uint32_t generation; // Bumped whenever slots move or keys are added or removed.
+    vars_section* sections;
+    uint32_t section_count;
+    uint32_t section_capacity;
+    uint32_t* section_slots; // Section index + 1 by name hash, 0 when free. Twice section_capacity long.
+    vars_pool pool; // Owned keys, values and section names.
+    vars_usage usage;
+    vars_order order;
+    vars_include_list includes;
+} vars_map;
+
+// The table grows once it is more than 3/4 full, so probe sequences stay short.
+#define VARS_MAP_MIN_CAPACITY VARS_GROUP_SIZE
+#define VARS_MAP_MAX_LOAD(capacity) ((capacity) - (capacity) / 4)
+
+// Returns a bitmask with bit i set when group[i] == ctrl.
+static uint32_t vars_group_match(const uint8_t* group, uint8_t ctrl) {
+#ifdef VARS_USE_SSE2
+    __m128i bytes = _mm_loadu_si128((const __m128i*)group);
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8((char)ctrl)));
+#else
+    uint32_t bits = 0;
+    for (int i = 0; i < VARS_GROUP_SIZE; i++) {
+        bits |= (uint32_t)(group[i] == ctrl) << i;
+    }
+    return bits;
+#endif
+}
+
+static size_t vars_map_capacity_for(size_t count) {
+    size_t capacity = VARS_MAP_MIN_CAPACITY;
+    while (VARS_MAP_MAX_LOAD(capacity) < count) capacity *= 2;
+    return capacity;
+}
+
+static int vars_map_alloc_slots(vars_map* map, size_t capacity) {
+    if (capacity < VARS_MAP_MIN_CAPACITY) capacity = VARS_MAP_MIN_CAPACITY;
+    map->ctrl = (uint8_t*)VARS_MALLOC(capacity);
+    map->entries = (vars_kv_pair*)vars__calloc(capacity, sizeof(vars_kv_pair));
+    if (!map->ctrl || !map->entries) {
+        VARS_FREE(map->ctrl);
+        VARS_FREE(map->entries);
+        map->ctrl = NULL;
+        map->entries = NULL;
+        return 0;
+    }
+    memset(map->ctrl, VARS_CTRL_EMPTY, capacity);
+    map->count = 0;
+    map->deleted = 0;
+    map->capacity = capacity;
+    map->mask = capacity - 1;
+    return 1;
+}
+
+static int vars_map_init(vars_map* map, size_t capacity) {
+    memset(map, 0, sizeof(*map));
+    map->sections = (vars_section*)VARS_MALLOC(4 * sizeof(vars_section));
+    map->section_slots = (uint32_t*)vars__calloc(8, sizeof(uint32_t));
+    if (!map->sections || !map->section_slots || !vars_map_alloc_slots(map, capacity)) {
+        VARS_FREE(map->sections);
+        VARS_FREE(map->section_slots);
+        memset(map, 0, sizeof(*map));
+        return 0;
+    }
+    map->section_capacity = 4;
+    map->section_count = 1;
+    map->sections[0].name = "";
+    map->sections[0].len = 0;
+    map->sections[0].hash = VARS_FNV_OFFSET;
+    map->sections[0].owned = 0;
+    map->generation = 1;
+    return 1;
+}
+
+static void vars_map_index_section(uint32_t* slots, uint32_t mask, uint32_t hash, uint32_t index) {
+    uint32_t pos = hash & mask;
+    while (slots[pos]) pos = (pos + 1) & mask;
+    slots[pos] = index + 1;
+}
+
+// Returns the index of the named section, or UINT32_MAX if there is none.
+static uint32_t vars_map_find_section(const vars_map* map, const char* name, size_t len, uint32_t hash) {
+    // The slots are never more than half full, so probes stay short.
+    uint32_t mask = map->section_capacity * 2 - 1;
+    for (uint32_t pos = hash & mask; map->section_slots[pos]; pos = (pos + 1) & mask) {
+        const vars_section* section = &map->sections[map->section_slots[pos] - 1];
+        if (section->hash == hash && section->len == len && memcmp(section->name, name, len) == 0) {
+            return map->section_slots[pos] - 1;
+        }
+    }
+    return UINT32_MAX;
+}
+
+// Returns the index of the named section, adding it if needed. Names are
+// borrowed unless copy is set.
+static uint32_t vars_map_section(vars_map* map, const char* name, size_t len, int copy) {
+    if (len == 0) return 0;
+    uint32_t hash = hash_fnv1a(hash_fnv1a(VARS_FNV_OFFSET, name, len), "/", 1);
+    uint32_t found = vars_map_find_section(map, name, len, hash);
+    if (found != UINT32_MAX) return found;
+    uint32_t mask = map->section_capacity * 2 - 1;
+
+    if (map->section_count == map->section_capacity) {
+        uint32_t new_capacity = map->section_capacity * 2;
+        vars_section* grown = (vars_section*)VARS_REALLOC(map->sections, new_capacity * sizeof(vars_section));
+        if (!grown) return UINT32_MAX;
+        map->sections = grown;
+        uint32_t* slots = (uint32_t*)vars__calloc((size_t)new_capacity * 2, sizeof(uint32_t));
+        if (!slots) return UINT32_MAX;
+        mask = new_capacity * 2 - 1;
+        for (uint32_t i = 1; i < map->section_count; i++) vars_map_index_section(slots, mask, map->sections[i].hash, i);
+        VARS_FREE(map->section_slots);
+        map->section_slots = slots;
+        map->section_capacity = new_capacity;
+    }
+
+    vars_section* section = &map->sections[map->section_count];
+    section->name = copy ? vars_pool_strndup(&map->pool, name, len) : name;
+    if (!section->name) return UINT32_MAX;
+    section->len = (uint32_t)len;
+    section->hash = hash;
+    section->owned = copy;
+    vars_map_index_section(map->section_slots, mask, hash, map->section_count);
+    return map->section_count++;
+}
+
+static size_t vars_map_home_group(const vars_map* map, uint32_t hash) {
+    return (size_t)hash & map->mask & ~(size_t)(VARS_GROUP_SIZE - 1);
+}
+
+// Places a pair into the first free slot. The caller makes sure there is room.
+static vars_kv_pair* vars_map_place(vars_map* map, const vars_kv_pair* pair) {
+    size_t pos = vars_map_home_group(map, pair->hash);
+
+    for (size_t probed = 0; probed < map->capacity; probed += VARS_GROUP_SIZE) {
+        uint32_t empty = vars_group_match(map->ctrl + pos, VARS_CTRL_EMPTY);
+        if (empty) {
+            size_t slot = pos + (size_t)vars__ctz(empty);
+            map->ctrl[slot] = VARS_HASH_TAG(pair->hash);
+            map->entries[slot] = *pair;
+            map->count++;
+            return &map->entries[slot];
+        }
+        pos = (pos + VARS_GROUP_SIZE) & map->mask;
+    }
+    return NULL;
+}
+
+static int vars_map_grow(vars_map* map, size_t new_capacity) {
+    vars_map grown = *map;
+    if (!vars_map_alloc_slots(&grown, new_capacity)) return 0;
+
+    for (size_t i = 0; i < map->capacity; i++) {
+        if (VARS_CTRL_IS_FULL(map->ctrl[i])) {
+            vars_map_place(&grown, &map->entries[i]);
+        }
+    }
+
+    grown.generation = map->generation + 1;
+    VARS_FREE(map->ctrl);
+    VARS_FREE(map->entries);
+    *map = grown;
+    return 1;
+}
+
+// Makes room for one more key. Tombstones are dropped by rehashing at the
+// same size when the live keys alone would still fit comfortably.
+static int vars_map_reserve(vars_map* map) {
+    if (map->count + map->deleted + 1 <= VARS_MAP_MAX_LOAD(map->capacity)) return 1;
+    if (!map->capacity) return vars_map_grow(map, VARS_MAP_MIN_CAPACITY);
+    size_t capacity = map->capacity;
+    if (map->count + 1 > VARS_MAP_MAX_LOAD(capacity) / 2) capacity *= 2;
+    return vars_map_grow(map, capacity);
+}
+
+static vars_kv_pair* vars_map_insert(vars_map* map, uint32_t section, const char* key, size_t key_len,
+                                     const char* value, size_t value_len, uint16_t flags) {
+    if (key_len > UINT16_MAX || value_len > UINT32_MAX) return NULL;
+    if (!vars_map_reserve(map)) return NULL;
+
+    vars_kv_pair pair;
+    pair.hash = hash_fnv1a(map->sections[section].hash, key, key_len);
+    pair.key_len = (uint16_t)key_len;
+    pair.flags = flags;
+    pair.value_len = (uint32_t)value_len;
+    pair.section = section;
+    pair.key = key;
+    pair.value = value;
+    vars__parse_value(value, value_len, &pair.typed);
+    map->generation++;
+    return vars_map_place(map, &pair);
+}
+
+// A qualified key split at its last '/'. Section names may contain slashes,
+// keys can't.
+typedef struct {
+    uint32_t hash;
+    const char* section;
+    size_t section_len;
+    const char* key;
+    size_t key_len;
+} vars_key_ref;
+
+static void vars__split_key(const char* qualified, vars_key_ref* ref) {
+    uint32_t hash = VARS_FNV_OFFSET;
+    const char* slash = NULL;
+    const char* cursor = qualified;
+    for (; *cursor; cursor++) {
+        if (*cursor == '/') slash = cursor;
+        hash ^= (uint8_t)*cursor;
+        hash *= VARS_FNV_PRIME;
+    }
+    ref->section = qualified;
+    ref->section_len = slash ? (size_t)(slash - qualified) : 0;
+    ref->key = slash ? slash + 1 : qualified;
+    ref->key_len = (size_t)(cursor - ref->key);
+    // "/key" names the global section, which is hashed without a slash.
+    ref->hash = slash == qualified ? hash_fnv1a(VARS_FNV_OFFSET, ref->key, ref->key_len) : hash;
+}
+
+static vars_kv_pair* vars_map_find_ref(vars_map* map, const vars_key_ref* ref) {
+    if (!map->capacity) return NULL;
+    uint8_t tag = VARS_HASH_TAG(ref->hash);
+    size_t pos = vars_map_home_group(map, ref->hash);
+
+    for (size_t probed = 0; probed < map->capacity; probed += VARS_GROUP_SIZE) {
+        const uint8_t* group = map->ctrl + pos;
+        uint32_t matches = vars_group_match(group, tag);
+        while (matches) {
+            vars_kv_pair* pair = &map->entries[pos + (size_t)vars__ctz(matches)];
+            if (pair->hash == ref->hash && pair->key_len == ref->key_len
+                && memcmp(pair->key, ref->key, ref->key_len) == 0) {
+                const vars_section* section = &map->sections[pair->section];
+                if (section->len == ref->section_len && memcmp(section->name, ref->section, ref->section_len) == 0) {
+                    return pair;
+                }
+            }
+            matches &= matches - 1;
+        }
+        // The load factor guarantees free slots, and a key never lives past the
+        // first group that still has one.
+        if (vars_group_match(group, VARS_CTRL_EMPTY)) return NULL;
+        pos = (pos + VARS_GROUP_SIZE) & map->mask;
+    }
+    return NULL;
+}
+
+static vars_kv_pair* vars_map_find(vars_map* map, const char* key) {
+    vars_key_ref ref;
+    vars__split_key(key, &ref);
+    return vars_map_find_ref(map, &ref);
+}
+
+// Frees what the pair owns and leaves a tombstone in its slot.
+static void vars_map_erase(vars_map* map, vars_kv_pair* pair) {
+    size_t slot = (size_t)(pair - map->entries);
+    if (pair->flags & VARS_PAIR_OWNS_KEY) vars_pool_free(&map->pool, pair->key, pair->key_len + 1);
+    if (pair->flags & VARS_PAIR_OWNS_VALUE) vars_pool_free(&map->pool, pair->value, pair->value_len + 1);
+    memset(pair, 0, sizeof(*pair));
+    map->ctrl[slot] = VARS_CTRL_DELETED;
+    map->count--;
+    map->deleted++;
+    map->generation++;
+}
+
+static void vars_map_free(vars_map* map) {
+    // Only strings too big for the pool's classes live outside its blocks.
+    for (size_t i = 0; i < map->capacity; i++) {
+        if (!VARS_CTRL_IS_FULL(map->ctrl[i])) continue;
+        const vars_kv_pair* pair = &map->entries[i];
+        if ((pair->flags & VARS_PAIR_OWNS_KEY) && pair->key_len + 1 > VARS_POOL_MAX_CLASS) VARS_FREE((char*)pair->key);
+        if ((pair->flags & VARS_PAIR_OWNS_VALUE) && pair->value_len + 1 > VARS_POOL_MAX_CLASS) VARS_FREE((char*)pair->value);
+    }
+    for (uint32_t i = 0; i < map->section_count; i++) {
+        const vars_section* section = &map->sections[i];
+        if (section->owned && section->len + 1 > VARS_POOL_MAX_CLASS) VARS_FREE((char*)section->name);
+    }
+    vars_pool_release(&map->pool);
+    VARS_FREE(map->order.slots);
+    VARS_FREE(map->order.starts);
+    VARS_FREE(map->order.sections);
+    VARS_FREE(map->order.ranks);
+    VARS_FREE(map->includes.lines); // The cached files are released by whoever holds the map.
+    VARS_FREE(map->sections);
+    VARS_FREE(map->section_slots);
+    VARS_FREE(map->ctrl);
+    VARS_FREE(map->entries);
+    memset(map, 0, sizeof(*map));
+}
+
+// ---------------------------------------------
+// HOT RELOAD SUPPORT
+// ---------------------------------------------
+
+// Whole seconds would miss a second save within the same second, so this
+// uses nanoseconds wherever stat() has them.
+static int64_t vars__get_file_mod_time(const char* file_path) {
+    struct stat st;
+    if (stat(file_path, &st) != 0) return -1;
+#if defined(__APPLE__)
+    return (int64_t)st.st_mtimespec.tv_sec * 1000000000 + st.st_mtimespec.tv_nsec;
+#elif defined(_POSIX_C_SOURCE) && _POSIX_C_SOURCE >= 200809L
+    return (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+#elif defined(__GLIBC__) && defined(__USE_XOPEN2K8)
+    return (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+#elif defined(__GLIBC__)
+    // Strict modes like -std=c99 hide st_mtim, but glibc still has the nanoseconds.
+    return (int64_t)st.st_mtime * 1000000000 + (int64_t)st.st_mtimensec;
+#else
+    return (int64_t)st.st_mtime * 1000000000;
+#endif
+}
+
+// ---------------------------------------------
+// FILE BUFFERS
+// ---------------------------------------------
+
+#define VARS_STORAGE_HEAP 0
+#define VARS_STORAGE_MMAP 1
+#define VARS_STORAGE_BINARY 2 // Only passed to vars__load; the buffer itself is a mapping.
+#define VARS_STORAGE_BORROWED 3 // The caller's memory, from vars_load_memory().
+#define VARS_STORAGE_MERGED 4 // No buffer: the read-only table of a vars_stack.
+
+static int vars__read_file(const char* file_path, vars_file* file) {
+    FILE* fp = fopen(file_path, "rb");
+    if (!fp) {
+        fprintf(stderr, "ERROR: vars_load: Failed to open file: %s\n", file_path);
+        return 0;
+    }
+    
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    rewind(fp);
+    
+    if (size <= 0) {
+        fprintf(stderr, "ERROR: vars_load: Invalid file size.\n");
+        fclose(fp);
+        return 0;
+    }
+    
+    file->filebuf = (char*)VARS_MALLOC(size);
+    if (!file->filebuf) {
+        fprintf(stderr, "ERROR: vars_load: Memory allocation failed.\n");
+        fclose(fp);
+        return 0;
+    }
+    
+    size_t read = fread(file->filebuf, 1, size, fp);
+    fclose(fp);
+    
+    if (read != (size_t)size) {
+        fprintf(stderr, "ERROR: vars_load: File read incomplete (%zu of %ld bytes).\n", read, size);
+        VARS_FREE(file->filebuf);
+        file->filebuf = NULL;
+        return 0;
+    }
+
+    file->filebuf_len = (size_t)size;
+    file->storage = VARS_STORAGE_HEAP;
+    return 1;
+}
+
+static int vars__map_file(const char* file_path, vars_file* file) {
+#ifdef _WIN32
+    HANDLE handle = CreateFileA(file_path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (handle == INVALID_HANDLE_VALUE) {
+        fprintf(stderr, "ERROR: vars_load_mmap: Failed to open file: %s\n", file_path);
+        return 0;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(handle, &size) || size.QuadPart <= 0) {
+        fprintf(stderr, "ERROR: vars_load_mmap: Invalid file size.\n");
+        CloseHandle(handle);
+        return 0;
+    }
+
+    // The view keeps the mapping object alive, so both handles can be closed now.
+    HANDLE mapping = CreateFileMappingA(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(handle);
+    if (!mapping) {
+        fprintf(stderr, "ERROR: vars_load_mmap: Failed to map file: %s\n", file_path);
+        return 0;
+    }
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (!view) {
+        fprintf(stderr, "ERROR: vars_load_mmap: Failed to map file: %s\n", file_path);
+        return 0;
+    }
+
+    file->filebuf = (char*)view;
+    file->filebuf_len = (size_t)size.QuadPart;
+#else
+    int fd = open(file_path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "ERROR: vars_load_mmap: Failed to open file: %s\n", file_path);
+        return 0;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        fprintf(stderr, "ERROR: vars_load_mmap: Invalid file size.\n");
+        close(fd);
+        return 0;
+    }
+
+    void* view = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED) {
+        fprintf(stderr, "ERROR: vars_load_mmap: Failed to map file: %s\n", file_path);
+        return 0;
+    }
+
+    file->filebuf = (char*)view;
+    file->filebuf_len = (size_t)st.st_size;
+#endif
+    file->storage = VARS_STORAGE_MMAP;
+    return 1;
+}
+
+static void vars__release_buffer(vars_file* file) {
+    if (!file->filebuf) return;
+    if (file->storage == VARS_STORAGE_MMAP) {
+#ifdef _WIN32
+        UnmapViewOfFile(file->filebuf);
+#else
+        munmap(file->filebuf, file->filebuf_len);
+#endif
+    } else if (file->storage != VARS_STORAGE_BORROWED) {
+        VARS_FREE(file->filebuf);
+    }
+    file->filebuf = NULL;
+    file->filebuf_len = 0;
+}
+
+// ---------------------------------------------
+// ATOMIC WRITES
+// ---------------------------------------------
+
+// Writes all of data to fd and flushes it to disk.
+static int vars__write_and_sync(int fd, const char* data, size_t len) {
+    while (len > 0) {
+#ifdef _WIN32
+        int n = _write(fd, data, len > INT_MAX ? INT_MAX : (unsigned int)len);
+#else
+        ssize_t n = write(fd, data, len);
+        if (n < 0 && errno == EINTR) continue;
+#endif
+        if (n <= 0) return 0;
+        data += n;
+        len -= (size_t)n;
+    }
+#ifdef _WIN32
+    return _commit(fd) == 0;
+#else
+    return fsync(fd) == 0;
+#endif
+}
+
+#define VARS_TEMP_ATTEMPTS 100
+
+// Creates a temp file next to file_path and returns its descriptor, or -1.
+// The name holds the process id and a counter and is created exclusively, so
+// two processes or threads saving the same file never share a temp file.
+// temp_path needs room for the path and 40 more characters.
+static int vars__create_temp(const char* file_path, char* temp_path, size_t temp_size, int mode, int binary) {
+    static unsigned int counter = 0; // Only a hint. O_EXCL settles any race on it.
+    for (int attempt = 0; attempt < VARS_TEMP_ATTEMPTS; attempt++) {
+#ifdef _WIN32
+        (void)mode;
+        snprintf(temp_path, temp_size, "%s.%lu.%u.tmp", file_path, (unsigned long)GetCurrentProcessId(), counter++);
+        int fd = _open(temp_path, _O_WRONLY | _O_CREAT | _O_EXCL | (binary ? _O_BINARY : _O_TEXT), _S_IREAD | _S_IWRITE);
+#else
+        (void)binary;
+        snprintf(temp_path, temp_size, "%s.%ld.%u.tmp", file_path, (long)getpid(), counter++);
+        int fd = open(temp_path, O_WRONLY | O_CREAT | O_EXCL, (mode_t)mode);
+#endif
+        if (fd >= 0 || errno != EEXIST) return fd;
+    }
+    return -1;
+}
+
+// Writes data to a temp file, flushes it to disk and renames it over path,
+// so a crash leaves either the old file or the new one, never half of each.
+// Renaming also means a file someone has mapped keeps its old contents.
+// Text mode only matters on Windows, where it writes \r\n line endings.
+static int vars__write_file_atomic(const char* file_path, const char* data, size_t len, int binary) {
+    size_t temp_size = strlen(file_path) + 41;
+    char* temp_path = (char*)VARS_MALLOC(temp_size);
+    if (!temp_path) return 0;
+
+#ifdef _WIN32
+    int fd = vars__create_temp(file_path, temp_path, temp_size, 0, binary);
+    FILE* fp = fd >= 0 ? _fdopen(fd, binary ? "wb" : "w") : NULL;
+    if (fd >= 0 && !fp) _close(fd);
+    int ok = fp != NULL;
+    if (ok) {
+        ok = fwrite(data, 1, len, fp) == len && fflush(fp) == 0 && _commit(_fileno(fp)) == 0;
+        if (fclose(fp) != 0) ok = 0;
+    }
+    if (ok && !MoveFileExA(temp_path, file_path, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) ok = 0;
+    if (!ok && fd >= 0) remove(temp_path);
+#else
+    // Keep the permissions of the file being replaced.
+    struct stat st;
+    mode_t mode = stat(file_path, &st) == 0 ? (st.st_mode & 07777) : 0666;
+    int fd = vars__create_temp(file_path, temp_path, temp_size, (int)mode, binary);
+    int ok = fd >= 0 && vars__write_and_sync(fd, data, len);
+    if (fd >= 0 && close(fd) != 0) ok = 0;
+    if (ok && rename(temp_path, file_path) != 0) ok = 0;
+
+    if (!ok) {
+        if (fd >= 0) remove(temp_path);
+    } else {
+        // The rename itself is only durable once the directory is synced.
+        // temp_path is long enough to hold the directory name.
+        const char* slash = strrchr(file_path, '/');
+        size_t dir_len = slash ? (slash == file_path ? 1 : (size_t)(slash - file_path)) : 1;
+        memcpy(temp_path, slash ? file_path : ".", dir_len);
+        temp_path[dir_len] = '\0';
+        int dir_fd = open(temp_path, O_RDONLY);
+        if (dir_fd >= 0) {
+            fsync(dir_fd);
+            close(dir_fd);
+        }
+    }
+#endif
+    VARS_FREE(temp_path);
+    return ok;
+}
+
+// ---------------------------------------------
+// ATOMICS
+// ---------------------------------------------
+
+#if defined(_MSC_VER) && !defined(__clang__)
+static uint64_t vars__atomic_load_u64(uint64_t* ptr) {
+    return (uint64_t)InterlockedCompareExchange64((volatile LONG64*)ptr, 0, 0);
+}
+static void vars__atomic_store_u64(uint64_t* ptr, uint64_t value) {
+    InterlockedExchange64((volatile LONG64*)ptr, (LONG64)value);
+}
+static void* vars__atomic_load_ptr(void** ptr) {
+    return InterlockedCompareExchangePointer((PVOID volatile*)ptr, NULL, NULL);
+}
+static void* vars__atomic_exchange_ptr(void** ptr, void* value) {
+    return InterlockedExchangePointer((PVOID volatile*)ptr, value);
+}
+static int vars__atomic_claim(int* flag) {
+    return InterlockedCompareExchange((volatile LONG*)flag, 1, 0) == 0;
+}
+static void vars__atomic_release_flag(int* flag) {
+    InterlockedExchange((volatile LONG*)flag, 0);
+}
+#else
+static uint64_t vars__atomic_load_u64(uint64_t* ptr) {
+    return __atomic_load_n(ptr, __ATOMIC_SEQ_CST);
+}
+static void vars__atomic_store_u64(uint64_t* ptr, uint64_t value) {
+    __atomic_store_n(ptr, value, __ATOMIC_SEQ_CST);
+}
+static void* vars__atomic_load_ptr(void** ptr) {
+    return __atomic_load_n(ptr, __ATOMIC_SEQ_CST);
+}
+static void* vars__atomic_exchange_ptr(void** ptr, void* value) {
+    return __atomic_exchange_n(ptr, value, __ATOMIC_SEQ_CST);
+}
+static int vars__atomic_claim(int* flag) {
+    int expected = 0;
+    return __atomic_compare_exchange_n(flag, &expected, 1, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+static void vars__atomic_release_flag(int* flag) {
+    __atomic_store_n(flag, 0, __ATOMIC_SEQ_CST);
+}
+#endif
+
+// ---------------------------------------------
+// PARSER
+// ---------------------------------------------
+
+static void vars__out_of_memory(void) {
+    fprintf(stderr, "ERROR: vars_load: Memory allocation failed.\n");
+    exit(EXIT_FAILURE);
+}
+
+typedef enum {
+    VARS_LINE_NONE,    // blank line, comment or something without a key
+    VARS_LINE_SECTION, // ":/name"
+    VARS_LINE_ENTRY,   // "key value"
+    VARS_LINE_INCLUDE  // ":include path"
+} vars_line_kind;
+
+typedef struct {
+    int kind;
+    const char* name; // section name, key or included path
+    size_t name_len;
+    const char* value;
+    size_t value_len;
+} vars_line;
+
+// Parses one line starting at cursor and returns where the next one starts.
+// A line normally ends after its run of line breaks, but a quoted value runs
+// until its closing quote, even across lines.
+static const char* vars__parse_line(const char* cursor, const char* end, vars_line* line) {
+    line->kind = VARS_LINE_NONE;
+
+    while (cursor < end && IS_WHITE_SPACE(*cursor)) cursor++;
+    if (cursor >= end) return cursor;
+    
+    if (*cursor == '#') {
+        cursor = vars__find_end_of_line(cursor, end);
+        while (cursor < end && IS_END_OF_LINE(*cursor)) cursor++;
+        return cursor;
+    }
+
+    if (*cursor == ':' && cursor + 1 < end && cursor[1] == '/') {
+        cursor += 2;
+        line->kind = VARS_LINE_SECTION;
+        line->name = cursor;
+        while (cursor < end && !IS_WHITE_SPACE(*cursor) && !IS_END_OF_LINE(*cursor)) cursor++;
+        line->name_len = (size_t)(cursor - line->name);
+        while (cursor < end && IS_END_OF_LINE(*cursor)) cursor++;
+        return cursor;
+    }
+
+    // The path runs to the end of the line or a comment.
+    if (*cursor == ':' && (size_t)(end - cursor) > 8 && memcmp(cursor + 1, "include", 7) == 0 && IS_WHITE_SPACE(cursor[8])) {
+        cursor += 8;
+        while (cursor < end && IS_WHITE_SPACE(*cursor)) cursor++;
+        line->name = cursor;
+        while (cursor < end && !IS_END_OF_LINE(*cursor) && *cursor != '#') cursor++;
+        const char* path_end = cursor;
+        while (path_end > line->name && IS_WHITE_SPACE(*(path_end - 1))) path_end--;
+        line->name_len = (size_t)(path_end - line->name);
+        if (line->name_len) line->kind = VARS_LINE_INCLUDE;
+        cursor = vars__find_end_of_line(cursor, end);
+        while (cursor < end && IS_END_OF_LINE(*cursor)) cursor++;
+        return cursor;
+    }
+
+    // Skip empty lines
+    if (IS_END_OF_LINE(*cursor)) {
+        while (cursor < end && IS_END_OF_LINE(*cursor)) cursor++;
+        return cursor;
+    }
+
+    const char* key = cursor;
+    while (cursor < end && (IS_LETTER(*cursor) || IS_NUMBER(*cursor) || IS_UNDERSCORE(*cursor) || IS_HYPHEN(*cursor))) cursor++;
+    
+    if (key == cursor) {
+        // No key found, skip this line
+        cursor = vars__find_end_of_line(cursor, end);
+        while (cursor < end && IS_END_OF_LINE(*cursor)) cursor++;
+        return cursor;
+    }
+    line->name = key;
+    line->name_len = (size_t)(cursor - key);
+
+    while (cursor < end && IS_WHITE_SPACE(*cursor)) cursor++;
+
+    const char* value = cursor;
+    const char* value_end;
+    if (cursor < end && *cursor == '"') {
+        const char* quote = (const char*)memchr(cursor + 1, '"', (size_t)(end - cursor - 1));
+        cursor = quote ? quote + 1 : end;
+        value_end = cursor;
+    } else {
+        cursor = vars__find_end_of_value(cursor, end);
+        // Trim trailing whitespace
+        value_end = cursor;
+        while (value_end > value && IS_WHITE_SPACE(*(value_end - 1))) value_end--;
+    }
+
+    line->kind = VARS_LINE_ENTRY;
+    line->value = value;
+    line->value_len = (size_t)(value_end - value);
+    while (cursor < end && IS_END_OF_LINE(*cursor)) cursor++;
+    return cursor;
+}
+
+static void vars__add_include_line(vars_map* map, const char* path, size_t len) {
+    vars_include_list* list = &map->includes;
+    if (len > UINT32_MAX) return;
+    if (list->count == list->capacity) {
+        uint32_t capacity = list->capacity ? list->capacity * 2 : 4;
+        vars_include_line* lines = (vars_include_line*)VARS_REALLOC(list->lines, capacity * sizeof(vars_include_line));
+        if (!lines) vars__out_of_memory();
+        list->lines = lines;
+        list->capacity = capacity;
+    }
+    vars_include_line* line = &list->lines[list->count++];
+    line->path = path;
+    line->len = (uint32_t)len;
+    line->include = NULL;
+}
+
+// Parses every line that starts before limit straight into the map, and
+// returns where parsing stopped. section holds the active section going in
+// and coming out.
+static const char* vars__parse_range(vars_map* map, const char* cursor, const char* limit, const char* end, uint32_t* section) {
+    vars_line line;
+    while (cursor < limit) {
+        cursor = vars__parse_line(cursor, end, &line);
+        if (line.kind == VARS_LINE_SECTION) {
+            *section = vars_map_section(map, line.name, line.name_len, 0);
+            if (*section == UINT32_MAX) vars__out_of_memory();
+        } else if (line.kind == VARS_LINE_ENTRY) {
+            vars_map_insert(map, *section, line.name, line.name_len, line.value, line.value_len, 0);
+        } else if (line.kind == VARS_LINE_INCLUDE) {
+            vars__add_include_line(map, line.name, line.name_len);
+        }
+    }
+    return cursor;
+}
+
+// ---------------------------------------------
+// PARALLEL PARSING
+// ---------------------------------------------
+
+// With VARS_ENABLE_THREADS defined, files of at least VARS_PARALLEL_MIN_SIZE
+// bytes are cut into one chunk per thread at line boundaries. Each thread
+// finds the last ":/" in its chunk, so every chunk can be told which section
+// it starts in. The threads then tokenize their chunks, hash the keys and
+// parse the values into private arrays, and the calling thread inserts the
+// results in file order.
+//
+// A quoted value may run past the end of its chunk, and a ":/" the quick
+// section scan saw may have been inside such a value. So each chunk's results
+// are only used if its start position and starting section agree with where
+// the chunk before it really stopped. Otherwise the chunk is parsed again on
+// the calling thread.
+
+#ifdef VARS_ENABLE_THREADS
+
+#ifndef VARS_THREAD_COUNT
+#define VARS_THREAD_COUNT 0 // 0 means one thread per online CPU.
+#endif
+
+#ifndef VARS_PARALLEL_MIN_SIZE
+#define VARS_PARALLEL_MIN_SIZE (4u << 20)
+#endif
+
+#define VARS_MAX_THREADS 64
+
+#ifdef _WIN32
+typedef HANDLE vars_thread;
+#else
+#include <pthread.h>
+typedef pthread_t vars_thread;
+#endif
+
+typedef struct {
+    const char* start;
+    const char* limit; // Lines starting at or after this belong to the next chunk.
+    const char* end;   // End of the whole buffer.
+    const char* stop;  // Where parsing really stopped. Past limit if a string ran over.
+    size_t line_count;
+    vars_line last_section; // From the section scan. VARS_LINE_NONE if there was none.
+    vars_section* sections; // sections[0] is the one the chunk starts in.
+    uint32_t section_count;
+    uint32_t section_capacity;
+    uint32_t* section_slots; // Indexed like vars_map.section_slots.
+    uint32_t section;       // Index into sections of the one active at stop.
+    vars_kv_pair* pairs;    // pair.section indexes into sections until merged.
+    size_t pair_count;
+    size_t pair_capacity;
+    int failed;
+} vars_chunk;
+
+typedef struct {
+    void (*work)(vars_chunk*);
+    vars_chunk* chunk;
+} vars_task;
+
+#ifdef _WIN32
+static DWORD WINAPI vars__thread_main(LPVOID arg) {
+    vars_task* task = (vars_task*)arg;
+    task->work(task->chunk);
+    return 0;
+}
+#else
+static void* vars__thread_main(void* arg) {
+    vars_task* task = (vars_task*)arg;
+    task->work(task->chunk);
+    return NULL;
+}
+#endif
+
+static int vars__thread_count(void) {
+    int count = VARS_THREAD_COUNT;
+    if (count <= 0) {
+#ifdef _WIN32
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        count = (int)info.dwNumberOfProcessors;
+#else
+        count = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    }
+    if (count < 1) count = 1;
+    if (count > VARS_MAX_THREADS) count = VARS_MAX_THREADS;
+    return count;
+}
+
+// Runs work on every chunk, the first one on the calling thread. Chunks whose
+// thread couldn't be started are run here too.
+static void vars__run_chunks(vars_chunk* chunks, int count, void (*work)(vars_chunk*)) {
+    vars_task tasks[VARS_MAX_THREADS];
+    vars_thread threads[VARS_MAX_THREADS];
+    int started[VARS_MAX_THREADS];
+
+    for (int i = 1; i < count; i++) {
+        tasks[i].work = work;
+        tasks[i].chunk = &chunks[i];
+#ifdef _WIN32
+        threads[i] = CreateThread(NULL, 0, vars__thread_main, &tasks[i], 0, NULL);
+        started[i] = threads[i] != NULL;
+#else
+        started[i] = pthread_create(&threads[i], NULL, vars__thread_main, &tasks[i]) == 0;
+#endif
+    }
+
+    work(&chunks[0]);
+
+    for (int i = 1; i < count; i++) {
+        if (!started[i]) {
+            work(&chunks[i]);
+            continue;
+        }
+#ifdef _WIN32
+        WaitForSingleObject(threads[i], INFINITE);
+        CloseHandle(threads[i]);
+#else
+        pthread_join(threads[i], NULL);
+#endif
+    }
+}
+
+static void vars__chunk_scan_sections(vars_chunk* chunk) {
+    const char* cursor = chunk->start;
+    chunk->line_count = vars__count_lines(chunk->start, chunk->limit) + 1;
+    chunk->last_section.kind = VARS_LINE_NONE;
+
+    while (cursor < chunk->limit) {
+        while (cursor < chunk->limit && IS_WHITE_SPACE(*cursor)) cursor++;
+        if (cursor + 1 < chunk->end && cursor[0] == ':' && cursor[1] == '/') {
+            chunk->last_section.kind = VARS_LINE_SECTION;
+            chunk->last_section.name = cursor + 2;
+            cursor += 2;
+            while (cursor < chunk->end && !IS_WHITE_SPACE(*cursor) && !IS_END_OF_LINE(*cursor)) cursor++;
+            chunk->last_section.name_len = (size_t)(cursor - chunk->last_section.name);
+        }
+        cursor = vars__find_end_of_line(cursor, chunk->limit);
+        while (cursor < chunk->limit && IS_END_OF_LINE(*cursor)) cursor++;
+    }
+}
+
+static uint32_t vars__chunk_section(vars_chunk* chunk, const char* name, size_t len) {
+    uint32_t hash = len ? hash_fnv1a(hash_fnv1a(VARS_FNV_OFFSET, name, len), "/", 1) : VARS_FNV_OFFSET;
+    uint32_t mask = chunk->section_capacity * 2 - 1;
+    for (uint32_t pos = hash & mask; chunk->section_capacity && chunk->section_slots[pos]; pos = (pos + 1) & mask) {
+        const vars_section* section = &chunk->sections[chunk->section_slots[pos] - 1];
+        if (section->hash == hash && section->len == len && memcmp(section->name, name, len) == 0) {
+            return chunk->section_slots[pos] - 1;
+        }
+    }
+
+    if (chunk->section_count == chunk->section_capacity) {
+        uint32_t new_capacity = chunk->section_capacity ? chunk->section_capacity * 2 : 8;
+        vars_section* grown = (vars_section*)VARS_REALLOC(chunk->sections, new_capacity * sizeof(vars_section));
+        if (!grown) return UINT32_MAX;
+        chunk->sections = grown;
+        uint32_t* slots = (uint32_t*)vars__calloc((size_t)new_capacity * 2, sizeof(uint32_t));
+        if (!slots) return UINT32_MAX;
+        mask = new_capacity * 2 - 1;
+        for (uint32_t i = 0; i < chunk->section_count; i++) vars_map_index_section(slots, mask, chunk->sections[i].hash, i);
+        VARS_FREE(chunk->section_slots);
+        chunk->section_slots = slots;
+        chunk->section_capacity = new_capacity;
+    }
+
+    vars_section* section = &chunk->sections[chunk->section_count];
+    section->name = name;
+    section->len = (uint32_t)len;
+    section->hash = hash;
+    section->owned = 0;
+    vars_map_index_section(chunk->section_slots, mask, hash, chunk->section_count);
+    return chunk->section_count++;
+}
+
+static void vars__chunk_parse(vars_chunk* chunk) {
+    const char* cursor = chunk->start;
+    vars_line line;
+
+    chunk->pair_capacity = chunk->line_count;
+    chunk->pairs = (vars_kv_pair*)VARS_MALLOC(chunk->pair_capacity * sizeof(vars_kv_pair));
+    if (!chunk->pairs) {
+        chunk->failed = 1;
+        return;
+    }
+
+    uint32_t section = 0;
+    while (cursor < chunk->limit) {
+        cursor = vars__parse_line(cursor, chunk->end, &line);
+        if (line.kind == VARS_LINE_SECTION) {
+            section = vars__chunk_section(chunk, line.name, line.name_len);
+            if (section == UINT32_MAX) {
+                chunk->failed = 1;
+                return;
+            }
+        } else if (line.kind == VARS_LINE_ENTRY) {
+            if (line.name_len > UINT16_MAX || line.value_len > UINT32_MAX) continue;
+            if (chunk->pair_count == chunk->pair_capacity) {
+                // A quoted value can be followed by another entry on the same line.
+                size_t new_capacity = chunk->pair_capacity * 2;
+                vars_kv_pair* grown = (vars_kv_pair*)VARS_REALLOC(chunk->pairs, new_capacity * sizeof(vars_kv_pair));
+                if (!grown) {
+                    chunk->failed = 1;
+                    return;
+                }
+                chunk->pairs = grown;
+                chunk->pair_capacity = new_capacity;
+            }
+
+            vars_kv_pair* pair = &chunk->pairs[chunk->pair_count++];
+            pair->hash = hash_fnv1a(chunk->sections[section].hash, line.name, line.name_len);
+            pair->key_len = (uint16_t)line.name_len;
+            pair->flags = 0;
+            pair->value_len = (uint32_t)line.value_len;
+            pair->section = section;
+            pair->key = line.name;
+            pair->value = line.value;
+            vars__parse_value(line.value, line.value_len, &pair->typed);
+        } else if (line.kind == VARS_LINE_INCLUDE) {
+            // Rare enough to leave to the sequential parse, which keeps the lines in order.
+            chunk->failed = 1;
+            return;
+        }
+    }
+
+    chunk->stop = cursor;
+    chunk->section = section;
+}
+
+static void vars__merge_chunk(vars_map* map, vars_chunk* chunk, uint32_t* section) {
+    uint32_t remap_local[64];
+    uint32_t* remap = chunk->section_count <= 64 ? remap_local : (uint32_t*)VARS_MALLOC(chunk->section_count * sizeof(uint32_t));
+    if (!remap) vars__out_of_memory();
+
+    remap[0] = *section;
+    for (uint32_t i = 1; i < chunk->section_count; i++) {
+        remap[i] = vars_map_section(map, chunk->sections[i].name, chunk->sections[i].len, 0);
+        if (remap[i] == UINT32_MAX) vars__out_of_memory();
+    }
+
+    for (size_t i = 0; i < chunk->pair_count; i++) {
+        vars_kv_pair* pair = &chunk->pairs[i];
+        pair->section = remap[pair->section];
+        if (!vars_map_reserve(map)) vars__out_of_memory();
+        vars_map_place(map, pair);
+    }
+    map->generation++;
+
+    *section = remap[chunk->section];
+    if (remap != remap_local) VARS_FREE(remap);
+}
+
+// Returns 0 without touching the map when the buffer isn't worth splitting.
+static int vars__parse_parallel(vars_map* map, const char* start, const char* end) {
+    int count = vars__thread_count();
+    if (count < 2 || (size_t)(end - start) < VARS_PARALLEL_MIN_SIZE) return 0;
+
+    vars_chunk chunks[VARS_MAX_THREADS];
+    memset(chunks, 0, sizeof(chunks));
+
+    // Cut at line starts. Skipping the whole run of line breaks puts each cut
+    // exactly where the parser would begin its next line.
+    const char* cut = start;
+    int chunk_count = 0;
+    size_t step = (size_t)(end - start) / (size_t)count;
+    for (int i = 0; i < count && cut < end; i++) {
+        const char* limit = end;
+        if (i + 1 < count) {
+            limit = cut + step;
+            if (limit >= end) {
+                limit = end;
+            } else {
+                limit = vars__find_end_of_line(limit, end);
+                while (limit < end && IS_END_OF_LINE(*limit)) limit++;
+            }
+        }
+        chunks[chunk_count].start = cut;
+        chunks[chunk_count].limit = limit;
+        chunks[chunk_count].end = end;
+        chunk_count++;
+        cut = limit;
+    }
+    if (chunk_count < 2) return 0;
+
+    vars__run_chunks(chunks, chunk_count, vars__chunk_scan_sections);
+
+    // Every chunk starts in the section named last before it.
+    vars_line incoming;
+    incoming.kind = VARS_LINE_NONE;
+    for (int i = 0; i < chunk_count; i++) {
+        const char* name = incoming.kind == VARS_LINE_SECTION ? incoming.name : "";
+        size_t len = incoming.kind == VARS_LINE_SECTION ? incoming.name_len : 0;
+        if (vars__chunk_section(&chunks[i], name, len) != 0) chunks[i].failed = 1;
+        if (chunks[i].last_section.kind == VARS_LINE_SECTION) incoming = chunks[i].last_section;
+    }
+
+    vars__run_chunks(chunks, chunk_count, vars__chunk_parse);
+
+    const char* position = start;
+    uint32_t section = 0;
+    for (int i = 0; i < chunk_count; i++) {
+        vars_chunk* chunk = &chunks[i];
+        const vars_section* actual = &map->sections[section];
+        int agrees = !chunk->failed && chunk->start == position
+                  && chunk->sections[0].len == actual->len
+                  && memcmp(chunk->sections[0].name, actual->name, actual->len) == 0;
+
+        if (agrees) {
+            vars__merge_chunk(map, chunk, &section);
+            position = chunk->stop;
+        } else if (position < chunk->limit) {
+            position = vars__parse_range(map, position, chunk->limit, end, &section);
+        }
+
+        VARS_FREE(chunk->pairs);
+        VARS_FREE(chunk->sections);
+        VARS_FREE(chunk->section_slots);
+    }
+    return 1;
+}
+
+#endif // VARS_ENABLE_THREADS
+
+static void vars__parse_buffer(vars_file* file) {
+    double started = vars__now();
+    const char* start = file->filebuf;
+    const char* end = file->filebuf + file->filebuf_len;
+
+    // Nearly every entry sits on its own line, so the line count is a cheap
+    // estimate of the number of keys. Sizing from it avoids rehashing while we parse.
+    size_t line_count = vars__count_lines(start, end) + 1;
+
+    file->map = (vars_map*)VARS_MALLOC(sizeof(vars_map));
+    if (!file->map || !vars_map_init(file->map, vars_map_capacity_for(line_count))) {
+        vars__out_of_memory();
+    }
+
+    int parsed = 0;
+#ifdef VARS_ENABLE_THREADS
+    parsed = vars__parse_parallel(file->map, start, end);
+#endif
+    if (!parsed) {
+        uint32_t section = 0;
+        vars__parse_range(file->map, start, end, end, &section);
+    }
+    file->map->usage.parse_seconds = vars__now() - started;
+}
+
+// ---------------------------------------------
+// INCLUDES
+// ---------------------------------------------
+
+// ":include path" pulls in the keys of another file, resolved against the
+// directory of the file that names it. Keys the including file sets itself
+// win, and of two includes the later one wins. Included files are parsed once
+// into a process-wide cache keyed by path and modification time, and every
+// file that includes one points into the same cached copy, so a common file
+// included by a hundred others is read and parsed once and its keys and values
+// are stored once. Each including file still adds a table entry per included key.
+//
+// Cache entries are reference counted. An entry stays cached after its last
+// user is freed, so loading the next file that includes it is free, until the
+// file changes on disk or vars_include_cache_clear() is called.
+
+#ifndef VARS_MAX_INCLUDE_DEPTH
+#define VARS_MAX_INCLUDE_DEPTH 32
+#endif
+
+#ifdef _WIN32
+#define IS_PATH_SEPARATOR(ch) (((ch) == '/') || ((ch) == '\\'))
+#else
+#define IS_PATH_SEPARATOR(ch) ((ch) == '/')
+#endif
+
+typedef struct vars_include {
+    char* path; // Resolved, the cache key along with last_modified.
+    int64_t last_modified;
+    vars_file file;
+    size_t refs;
+    int cached; // Still in the cache, where new includes can find it.
+    struct vars_include* next;
+} vars_include;
+
+// The files being loaded, innermost first, to catch a file including itself.
+typedef struct vars_include_chain {
+    const char* path;
+    const struct vars_include_chain* parent;
+    int depth;
+} vars_include_chain;
+
+static vars_include* vars__include_cache = NULL;
+static int vars__include_lock = 0;
+
+static void vars__include_cache_lock(void) {
+    // Only list updates happen under the lock. Files are read and parsed outside it.
+    while (!vars__atomic_claim(&vars__include_lock)) {}
+}
+
+static void vars__include_cache_unlock(void) {
+    vars__atomic_release_flag(&vars__include_lock);
+}
+
+// Joins path to the directory of the including file and drops "." and
+// "dir/.." parts, so a file has one cache key however it's spelled and a
+// cycle can't hide behind a different spelling.
+static char* vars__include_path(const char* including, const char* path, size_t len) {
+    size_t dir_len = 0;
+    int absolute = IS_PATH_SEPARATOR(path[0]) || (len > 1 && path[1] == ':');
+    if (!absolute && including) {
+        for (size_t i = 0; including[i]; i++) {
+            if (IS_PATH_SEPARATOR(including[i])) dir_len = i + 1;
+        }
+    }
+
+    size_t total = dir_len + len;
+    char* out = (char*)VARS_MALLOC(total + 1);
+    if (!out) vars__out_of_memory();
+    if (dir_len) memcpy(out, including, dir_len);
+    memcpy(out + dir_len, path, len);
+
+    // Rewrites the path in place one part at a time. written never passes read.
+    size_t read = 0, written = 0;
+    while (read < total) {
+        size_t start = read;
+        while (read < total && !IS_PATH_SEPARATOR(out[read])) read++;
+        size_t part = read - start;
+        size_t separator = read < total ? 1 : 0;
+        read += separator;
+
+        if ((part == 0 && written > 0) || (part == 1 && out[start] == '.')) continue;
+        if (part == 2 && out[start] == '.' && out[start + 1] == '.' && written > 0) {
+            // Only a named directory can be backed out of, not the root or "..".
+            size_t previous = written - 1;
+            while (previous > 0 && !IS_PATH_SEPARATOR(out[previous - 1])) previous--;
+            size_t previous_len = written - 1 - previous;
+            int named = previous_len > 0 && !(previous_len == 2 && out[previous] == '.' && out[previous + 1] == '.')
+                     && out[written - 2] != ':';
+            if (named) {
+                written = previous;
+                continue;
+            }
+        }
+        memmove(out + written, out + start, part + separator);
+        written += part + separator;
+    }
+    if (!written) out[written++] = '.';
+    out[written] = '\0';
+    return out;
+}
+
+// Takes a reference to the cached copy of path if it was parsed at mod_time.
+static vars_include* vars__include_find(const char* path, int64_t mod_time) {
+    vars__include_cache_lock();
+    vars_include* include = vars__include_cache;
+    while (include && (include->last_modified != mod_time || strcmp(include->path, path) != 0)) include = include->next;
+    if (include) include->refs++;
+    vars__include_cache_unlock();
+    return include;
+}
+
+static void vars__include_release(vars_include* include) {
+    vars__include_cache_lock();
+    int unused = --include->refs == 0 && !include->cached;
+    vars__include_cache_unlock();
+    if (!unused) return;
+
+    vars_include_list* list = &include->file.map->includes;
+    for (uint32_t i = 0; i < list->count; i++) {
+        if (list->lines[i].include) vars__include_release(list->lines[i].include);
+    }
+    vars_map_free(include->file.map);
+    VARS_FREE(include->file.map);
+    vars__release_buffer(&include->file);
+    VARS_FREE(include->path);
+    VARS_FREE(include);
+}
+
+// Releases every file the map's ":include" lines loaded.
+static void vars__release_includes(vars_map* map) {
+    for (uint32_t i = 0; i < map->includes.count; i++) {
+        if (map->includes.lines[i].include) vars__include_release(map->includes.lines[i].include);
+        map->includes.lines[i].include = NULL;
+    }
+}
+
+// Caches a freshly parsed file, which starts with the caller's reference, in
+// place of any older copy. Copies still in use live on until released.
+static void vars__include_add(vars_include* include) {
+    vars_include* replaced = NULL;
+    include->refs = 1;
+    include->cached = 1;
+
+    vars__include_cache_lock();
+    vars_include** link = &vars__include_cache;
+    while (*link && strcmp((*link)->path, include->path) != 0) link = &(*link)->next;
+    if (*link) {
+        // Holding a reference while unlinking it leaves the freeing to vars__include_release.
+        replaced = *link;
+        *link = replaced->next;
+        replaced->cached = 0;
+        replaced->refs++;
+    }
+    include->next = vars__include_cache;
+    vars__include_cache = include;
+    vars__include_cache_unlock();
+
+    if (replaced) vars__include_release(replaced);
+}
+
+// Whether a file the map includes, or one those include, changed on disk
+// since it was parsed.
+static int vars__includes_stale(const vars_map* map) {
+    for (uint32_t i = 0; i < map->includes.count; i++) {
+        const vars_include* include = map->includes.lines[i].include;
+        if (!include) continue;
+        if (vars__get_file_mod_time(include->path) != include->last_modified) return 1;
+        if (vars__includes_stale(include->file.map)) return 1;
+    }
+    return 0;
+}
+
+// Adds the keys of each included file that the map doesn't have yet. Later
+// includes go first, so they win over earlier ones. The keys and values stay
+// in the cached file, and only section names are copied, since the sections
+// of a map can outlive its includes across a hot reload.
+static void vars__merge_includes(vars_map* map) {
+    for (uint32_t i = map->includes.count; i-- > 0;) {
+        const vars_map* source = map->includes.lines[i].include->file.map;
+        uint32_t* section_map = (uint32_t*)VARS_MALLOC(source->section_count * sizeof(uint32_t));
+        if (!section_map) vars__out_of_memory();
+        for (uint32_t s = 0; s < source->section_count; s++) section_map[s] = UINT32_MAX;
+
+        for (size_t slot = 0; slot < source->capacity; slot++) {
+            if (!VARS_CTRL_IS_FULL(source->ctrl[slot])) continue;
+            const vars_kv_pair* pair = &source->entries[slot];
+            const vars_section* section = &source->sections[pair->section];
+
+            vars_key_ref ref;
+            ref.hash = pair->hash;
+            ref.section = section->name;
+            ref.section_len = section->len;
+            ref.key = pair->key;
+            ref.key_len = pair->key_len;
+            // Only the entry lookups find counts when the file repeats a key.
+            if (vars_map_find_ref((vars_map*)source, &ref) != pair) continue;
+            if (vars_map_find_ref(map, &ref)) continue;
+
+            if (section_map[pair->section] == UINT32_MAX) {
+                section_map[pair->section] = vars_map_section(map, section->name, section->len, 1);
+                if (section_map[pair->section] == UINT32_MAX) vars__out_of_memory();
+            }
+            vars_kv_pair added = *pair;
+            added.flags = VARS_PAIR_INCLUDED;
+            added.section = section_map[pair->section];
+            if (!vars_map_reserve(map)) vars__out_of_memory();
+            vars_map_place(map, &added);
+        }
+        map->generation++;
+        VARS_FREE(section_map);
+    }
+}
+
+// Loads what the map's ":include" lines name, through the cache, and merges
+// it in. file_path is the file the map was parsed from. Returns 0 if an
+// include is missing, includes itself or nests too deep, leaving the includes
+// loaded so far on the map for the caller to release.
+static int vars__load_includes(vars_map* map, const char* file_path, int storage, const vars_include_chain* including) {
+    if (!map->includes.count) return 1;
+
+    vars_include_chain chain;
+    chain.path = file_path;
+    chain.parent = including;
+    chain.depth = including ? including->depth + 1 : 0;
+    if (chain.depth >= VARS_MAX_INCLUDE_DEPTH) {
+        fprintf(stderr, "ERROR: vars_load: Includes nested more than %d deep in %s\n", VARS_MAX_INCLUDE_DEPTH, file_path);
+        return 0;
+    }
+
+    for (uint32_t i = 0; i < map->includes.count; i++) {
+        vars_include_line* line = &map->includes.lines[i];
+        char* path = vars__include_path(file_path, line->path, line->len);
+        for (const vars_include_chain* link = &chain; link; link = link->parent) {
+            if (strcmp(link->path, path) == 0) {
+                fprintf(stderr, "ERROR: vars_load: %s includes itself through %s\n", path, file_path);
+                VARS_FREE(path);
+                return 0;
+            }
+        }
+
+        int64_t mod_time = vars__get_file_mod_time(path);
+        vars_include* include = vars__include_find(path, mod_time);
+        if (include && vars__includes_stale(include->file.map)) {
+            vars__include_release(include);
+            include = NULL;
+        }
+        if (include) {
+            VARS_FREE(path);
+            line->include = include;
+            continue;
+        }
+
+        include = (vars_include*)vars__calloc(1, sizeof(vars_include));
+        if (!include) vars__out_of_memory();
+        include->path = path;
+        include->last_modified = mod_time;
+        int loaded = storage == VARS_STORAGE_MMAP ? vars__map_file(path, &include->file) : vars__read_file(path, &include->file);
+        if (!loaded) {
+            VARS_FREE(path);
+            VARS_FREE(include);
+            return 0;
+        }
+        vars__parse_buffer(&include->file);
+        if (!vars__load_includes(include->file.map, path, storage, &chain)) {
+            // Not cached yet, so dropping the only reference frees it.
+            include->refs = 1;
+            vars__include_release(include);
+            return 0;
+        }
+        vars__include_add(include);
+        line->include = include;
+    }
+
+    vars__merge_includes(map);
+    return 1;
+}
+
+// Drops the cached files no loaded file includes any more. Returns how many
+// were freed. Files still in use stay cached.
+VARSAPI size_t vars_include_cache_clear(void) {
+    size_t freed = 0;
+    for (;;) {
+        // Freeing a file can leave the files it included unused, so sweep until nothing is.
+        vars_include* unused = NULL;
+        vars__include_cache_lock();
+        vars_include** link = &vars__include_cache;
+        while (*link) {
+            vars_include* include = *link;
+            if (include->refs) {
+                link = &include->next;
+                continue;
+            }
+            *link = include->next;
+            include->cached = 0;
+            include->refs = 1;
+            include->next = unused;
+            unused = include;
+        }
+        vars__include_cache_unlock();
+        if (!unused) return freed;
+
+        while (unused) {
+            vars_include* next = unused->next;
+            vars__include_release(unused);
+            unused = next;
+            freed++;
+        }
+    }
+}
+
+// Reads and parses a text file with its includes. Returns 1 on success and 0
+// on failure, with nothing left to free.
+static int vars__parse_file(const char* file_path, int storage, vars_file* file) {
+    memset(file, 0, sizeof(*file));
+    int loaded = storage == VARS_STORAGE_MMAP ? vars__map_file(file_path, file) : vars__read_file(file_path, file);
+    if (!loaded) return 0;
+
+    vars__parse_buffer(file);
+    if (!vars__load_includes(file->map, file_path, storage, NULL)) {
+        vars_free(*file);
+        memset(file, 0, sizeof(*file));
+        return 0;
+    }
+    return 1;
+}
+
+static vars_file vars__load_and_parse_file(const char* file_path, int storage) {
+    vars_file file;
+    if (!vars__parse_file(file_path, storage, &file)) exit(EXIT_FAILURE);
+    return file;
+}
+
+// ---------------------------------------------
+// STREAMING
+// ---------------------------------------------
+
+// vars_parse_stream() reads its input in chunks and hands each entry to a
+// callback instead of building a map, so memory stays at about one chunk no
+// matter how big the input is, and pipes work since nothing seeks. A line that
+// runs past the data read so far is parsed again once more has arrived. The
+// buffer only grows for a line longer than itself.
+
+#ifndef VARS_STREAM_CHUNK_SIZE
+#define VARS_STREAM_CHUNK_SIZE (64 * 1024)
+#endif
+
+static size_t vars__read_stream(void* context, char* buffer, size_t size) {
+    FILE* stream = (FILE*)context;
+    size_t read = fread(buffer, 1, size, stream);
+    if (read == 0 && ferror(stream)) return VARS_READ_ERROR;
+    return read;
+}
+
+// Parses everything read from stream, which may be a pipe or stdin. Returns 1
+// once the input ends or on_entry stops it, and 0 if reading fails or memory
+// runs out.
+VARSAPI int vars_parse_stream(FILE* stream, vars_entry_callback on_entry, void* user_data) {
+    if (!stream) return 0;
+    return vars_parse_reader(vars__read_stream, stream, on_entry, user_data);
+}
+
+// Like vars_parse_stream(), reading through a callback.
+VARSAPI int vars_parse_reader(vars_read_callback read, void* context, vars_entry_callback on_entry, void* user_data) {
+    if (!read || !on_entry) return 0;
+
+    size_t capacity = VARS_STREAM_CHUNK_SIZE;
+    char* buffer = (char*)VARS_MALLOC(capacity);
+    if (!buffer) return 0;
+
+    // The section name is copied out, since the line that named it leaves the buffer.
+    char* section = NULL;
+    size_t section_len = 0;
+    size_t section_capacity = 0;
+
+    size_t filled = 0;
+    int at_end = 0;
+    int ok = 1;
+    while (ok) {
+        if (filled == capacity) {
+            char* grown = (char*)VARS_REALLOC(buffer, capacity * 2);
+            if (!grown) {
+                ok = 0;
+                break;
+            }
+            buffer = grown;
+            capacity *= 2;
+        }
+        size_t count = read(context, buffer + filled, capacity - filled);
+        if (count == VARS_READ_ERROR) {
+            ok = 0;
+            break;
+        }
+        if (count == 0) at_end = 1;
+        filled += count;
+
+        const char* cursor = buffer;
+        const char* end = buffer + filled;
+        int stopped = 0;
+        while (cursor < end) {
+            vars_line line;
+            const char* next = vars__parse_line(cursor, end, &line);
+            // Reaching the end means the line may go on in the next chunk.
+            if (next == end && !at_end) break;
+
+            if (line.kind == VARS_LINE_SECTION) {
+                if (line.name_len > section_capacity) {
+                    char* grown = (char*)VARS_REALLOC(section, line.name_len);
+                    if (!grown) {
+                        ok = 0;
+                        break;
+                    }
+                    section = grown;
+                    section_capacity = line.name_len;
+                }
+                if (line.name_len) memcpy(section, line.name, line.name_len);
+                section_len = line.name_len;
+            } else if (line.kind == VARS_LINE_ENTRY) {
+                if (!on_entry(section_len ? section : "", section_len, line.name, line.name_len,
+                              line.value, line.value_len, user_data)) {
+                    stopped = 1;
+                    break;
+                }
+            }
+            cursor = next;
+        }
+        if (stopped || at_end) break;
+
+        // Keep the unfinished line for the next round
+        filled -= (size_t)(cursor - buffer);
+        memmove(buffer, cursor, filled);
+    }
+
+    VARS_FREE(section);
+    VARS_FREE(buffer);
+    return ok;
+}
+
+// ---------------------------------------------
+// COMPILED BINARY FILES
+// ---------------------------------------------
+
+// vars_compile() turns a text file into a .varsb file that vars_load_binary()
+// maps and uses as is. The layout, with every offset from the start of the file:
+//
+//   vars_binary_header
+//   uint32_t seeds[bucket_count]       perfect hash displacements
+//   vars_binary_entry entries[count]   one per key, at the slot its key hashes to
+//   char strings[strings_size]         qualified keys ("section/key") and raw values
+//
+// The perfect hash is hash-and-displace: a key's 64-bit FNV-1a hash picks a
+// bucket, and the bucket's seed, mixed with the hash, picks the entry. A seed
+// with the top bit set is the entry index itself, for buckets holding a single
+// key. Unknown keys still land on some entry, so lookups compare the stored
+// key. The map's 32-bit hashes aren't used here because a million keys
+// already have dozens of collisions, which no seed can separate.
+//
+// Values are stored already parsed, in host byte order and struct layout, so
+// a .varsb file is only meant for the platform that compiled it.
+
+#define VARS_BINARY_MAGIC "VARB"
+#define VARS_BINARY_VERSION 1
+#define VARS_BINARY_DIRECT 0x80000000u
+#define VARS_BINARY_MAX_SEED 0x7fffffffu
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t entry_size; // sizeof(vars_binary_entry), catches layout mismatches.
+    uint32_t count;
+    uint32_t bucket_count;
+    uint32_t seeds_offset;
+    uint32_t entries_offset;
+    uint32_t strings_offset;
+    uint32_t strings_size;
+    uint32_t reserved;
+} vars_binary_header;
+
+typedef struct {
+    uint32_t hash; // Low half of the 64-bit hash, to skip most key compares.
+    uint32_t key_offset;
+    uint32_t key_len;
+    uint32_t value_offset;
+    uint32_t value_len;
+    vars_value typed;
+} vars_binary_entry;
+
+typedef struct vars_binary {
+    const uint32_t* seeds;
+    const vars_binary_entry* entries;
+    const char* strings;
+    uint32_t strings_size;
+    uint32_t count;
+    uint32_t bucket_count;
+    uint32_t generation;
+    vars_usage usage;
+} vars_binary;
+
+#define VARS_FNV64_OFFSET 0xcbf29ce484222325ull
+#define VARS_FNV64_PRIME 0x100000001b3ull
+
+static uint64_t vars__hash64(uint64_t hash, const char* data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (uint8_t)data[i];
+        hash *= VARS_FNV64_PRIME;
+    }
+    return hash;
+}
+
+static uint64_t vars__mix(uint64_t hash, uint32_t seed) {
+    uint64_t x = hash ^ (seed * 0x9e3779b97f4a7c15ull);
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebull;
+    x ^= x >> 31;
+    return x;
+}
+
+// Maps the top 32 bits of a mixed hash onto [0, range) with a multiply
+// instead of a division.
+static uint32_t vars__reduce(uint64_t mixed, uint32_t range) {
+    return (uint32_t)(((mixed >> 32) * range) >> 32);
+}
+
+static uint32_t vars__binary_slot(const uint32_t* seeds, uint32_t bucket_count, uint32_t count, uint64_t hash) {
+    uint32_t seed = seeds[vars__reduce(vars__mix(hash, 0), bucket_count)];
+    if (seed & VARS_BINARY_DIRECT) return seed & ~VARS_BINARY_DIRECT;
+    return vars__reduce(vars__mix(hash, seed), count);
+}
+
+static uint32_t vars__binary_find(const vars_binary* bin, const char* key) {
+    if (!bin->count) return UINT32_MAX;
+    if (key[0] == '/' && !strchr(key + 1, '/')) key++; // The global section, as in vars__split_key.
+    uint64_t hash = VARS_FNV64_OFFSET;
+    size_t len = 0;
+    for (; key[len]; len++) {
+        hash ^= (uint8_t)key[len];
+        hash *= VARS_FNV64_PRIME;
+    }
+
+    // The file is only checked as far as it is used, so damaged offsets read
+    // as missing keys instead of going out of bounds.
+    uint32_t index = vars__binary_slot(bin->seeds, bin->bucket_count, bin->count, hash);
+    if (index >= bin->count) return UINT32_MAX;
+    const vars_binary_entry* entry = &bin->entries[index];
+    if (entry->hash != (uint32_t)hash || entry->key_len != len) return UINT32_MAX;
+    if ((uint64_t)entry->key_offset + entry->key_len > bin->strings_size) return UINT32_MAX;
+    if ((uint64_t)entry->value_offset + entry->value_len > bin->strings_size) return UINT32_MAX;
+    if (memcmp(bin->strings + entry->key_offset, key, len) != 0) return UINT32_MAX;
+    return index;
+}
+
+// Fills out with views into the mapping so the usual getters can read the entry.
+static const vars_kv_pair* vars__binary_pair(const vars_binary* bin, uint32_t index, vars_kv_pair* out) {
+    if (index == UINT32_MAX) return NULL;
+    const vars_binary_entry* entry = &bin->entries[index];
+    out->hash = 0;
+    out->key_len = 0;
+    out->flags = 0;
+    out->value_len = entry->value_len;
+    out->section = 0;
+    out->key = bin->strings + entry->key_offset;
+    out->value = bin->strings + entry->value_offset;
+    out->typed = entry->typed;
+    return out;
+}
+
+typedef struct {
+    uint32_t bucket;
+    uint32_t size;
+    uint32_t first; // Index into the bucket-sorted key list.
+} vars_bucket_info;
+
+static int vars__bucket_size_compare(const void* a, const void* b) {
+    const vars_bucket_info* ba = (const vars_bucket_info*)a;
+    const vars_bucket_info* bb = (const vars_bucket_info*)b;
+    if (ba->size != bb->size) return ba->size > bb->size ? -1 : 1;
+    return ba->bucket < bb->bucket ? -1 : ba->bucket > bb->bucket;
+}
+
+// Fills seeds so that every hash gets its own slot in [0, count). The hashes
+// must be unique. Big buckets are placed first, while the table is still empty.
+static int vars__build_perfect_hash(const uint64_t* hashes, uint32_t count, uint32_t* seeds, uint32_t bucket_count) {
+    vars_bucket_info* buckets = (vars_bucket_info*)vars__calloc(bucket_count, sizeof(vars_bucket_info));
+    uint32_t* order = (uint32_t*)VARS_MALLOC((count ? count : 1) * sizeof(uint32_t));
+    uint32_t* slots = (uint32_t*)VARS_MALLOC((count ? count : 1) * sizeof(uint32_t));
+    uint8_t* taken = (uint8_t*)vars__calloc(count ? count : 1, 1);
+    int ok = buckets && order && slots && taken;
+
+    if (ok) {
+        // Counting sort of the keys by bucket.
+        for (uint32_t i = 0; i < bucket_count; i++) buckets[i].bucket = i;
+        for (uint32_t i = 0; i < count; i++) buckets[vars__reduce(vars__mix(hashes[i], 0), bucket_count)].size++;
+        uint32_t first = 0;
+        for (uint32_t i = 0; i < bucket_count; i++) {
+            buckets[i].first = first;
+            first += buckets[i].size;
+            buckets[i].size = 0;
+        }
+        for (uint32_t i = 0; i < count; i++) {
+            vars_bucket_info* bucket = &buckets[vars__reduce(vars__mix(hashes[i], 0), bucket_count)];
+            order[bucket->first + bucket->size++] = i;
+        }
+        qsort(buckets, bucket_count, sizeof(vars_bucket_info), vars__bucket_size_compare);
+    }
+
+    uint32_t free_slot = 0;
+    for (uint32_t b = 0; ok && b < bucket_count; b++) {
+        vars_bucket_info* bucket = &buckets[b];
+        seeds[bucket->bucket] = 0;
+        if (bucket->size == 0) continue;
+
+        if (bucket->size == 1) {
+            while (taken[free_slot]) free_slot++;
+            taken[free_slot] = 1;
+            seeds[bucket->bucket] = VARS_BINARY_DIRECT | free_slot;
+            continue;
+        }
+
+        uint32_t seed = 1;
+        for (; seed <= VARS_BINARY_MAX_SEED; seed++) {
+            uint32_t placed = 0;
+            for (; placed < bucket->size; placed++) {
+                uint32_t slot = vars__reduce(vars__mix(hashes[order[bucket->first + placed]], seed), count);
+                if (taken[slot]) break;
+                taken[slot] = 1;
+                slots[placed] = slot;
+            }
+            if (placed == bucket->size) break;
+            while (placed--) taken[slots[placed]] = 0;
+        }
+        if (seed > VARS_BINARY_MAX_SEED) ok = 0;
+        seeds[bucket->bucket] = seed;
+    }
+
+    VARS_FREE(buckets);
+    VARS_FREE(order);
+    VARS_FREE(slots);
+    VARS_FREE(taken);
+    return ok;
+}
+
+static int vars__hash_compare(const void* a, const void* b) {
+    uint64_t ha = *(const uint64_t*)a;
+    uint64_t hb = *(const uint64_t*)b;
+    return ha < hb ? -1 : ha > hb;
+}
+
+static size_t vars__align8(size_t offset) {
+    return (offset + 7) & ~(size_t)7;
+}
+
+// Compiles the text file at src into a binary file at dst. When the text
+// repeats a key, the entry vars_get_* would return is the one compiled.
+// Returns 1 on success and 0 on failure.
+VARSAPI int vars_compile(const char* src, const char* dst) {
+    if (!src || !dst) return 0;
+
+    // Includes are compiled in, since a compiled file can't point into others.
+    vars_file text = {0};
+    if (!vars__read_file(src, &text)) return 0;
+    vars__parse_buffer(&text);
+    if (!vars__load_includes(text.map, src, VARS_STORAGE_HEAP, NULL)) {
+        vars_free(text);
+        return 0;
+    }
+    vars_map* map = text.map;
+
+    // Keep only the entry lookups find for each key, in slot order.
+    uint32_t count = 0;
+    size_t strings_size = 0;
+    uint32_t* indices = (uint32_t*)VARS_MALLOC((map->count ? map->count : 1) * sizeof(uint32_t));
+    uint64_t* hashes = (uint64_t*)VARS_MALLOC((map->count ? map->count : 1) * sizeof(uint64_t));
+    int ok = indices && hashes;
+    for (size_t i = 0; ok && i < map->capacity; i++) {
+        if (!VARS_CTRL_IS_FULL(map->ctrl[i])) continue;
+        const vars_kv_pair* pair = &map->entries[i];
+        const vars_section* section = &map->sections[pair->section];
+
+        vars_key_ref ref;
+        ref.hash = pair->hash;
+        ref.section = section->name;
+        ref.section_len = section->len;
+        ref.key = pair->key;
+        ref.key_len = pair->key_len;
+        if (vars_map_find_ref(map, &ref) != pair) continue;
+
+        uint64_t hash = VARS_FNV64_OFFSET;
+        if (section->len) hash = vars__hash64(vars__hash64(hash, section->name, section->len), "/", 1);
+        indices[count] = (uint32_t)i;
+        hashes[count] = vars__hash64(hash, pair->key, pair->key_len);
+        count++;
+        strings_size += (section->len ? section->len + 1 : 0) + pair->key_len + pair->value_len;
+    }
+
+    // Two different keys with the same 64-bit hash can't share a perfect hash.
+    // That is rare enough to just report it.
+    uint64_t* sorted = ok ? (uint64_t*)VARS_MALLOC((count ? count : 1) * sizeof(uint64_t)) : NULL;
+    if (sorted) {
+        memcpy(sorted, hashes, count * sizeof(uint64_t));
+        qsort(sorted, count, sizeof(uint64_t), vars__hash_compare);
+        for (uint32_t i = 1; i < count; i++) {
+            if (sorted[i] == sorted[i - 1]) {
+                fprintf(stderr, "ERROR: vars_compile: Two keys share a hash in %s.\n", src);
+                ok = 0;
+                break;
+            }
+        }
+        VARS_FREE(sorted);
+    } else {
+        ok = 0;
+    }
+
+    vars_binary_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, VARS_BINARY_MAGIC, 4);
+    header.version = VARS_BINARY_VERSION;
+    header.entry_size = (uint32_t)sizeof(vars_binary_entry);
+    header.count = count;
+    header.bucket_count = count / 2 + 1;
+
+    size_t seeds_offset = vars__align8(sizeof(header));
+    size_t entries_offset = vars__align8(seeds_offset + header.bucket_count * sizeof(uint32_t));
+    size_t strings_offset = entries_offset + (size_t)count * sizeof(vars_binary_entry);
+    size_t total = strings_offset + strings_size;
+    if (total > UINT32_MAX) ok = 0;
+
+    char* out = ok ? (char*)vars__calloc(1, total) : NULL;
+    if (!out) ok = 0;
+
+    if (ok) {
+        header.seeds_offset = (uint32_t)seeds_offset;
+        header.entries_offset = (uint32_t)entries_offset;
+        header.strings_offset = (uint32_t)strings_offset;
+        header.strings_size = (uint32_t)strings_size;
+        memcpy(out, &header, sizeof(header));
+
+        uint32_t* seeds = (uint32_t*)(out + seeds_offset);
+        if (!vars__build_perfect_hash(hashes, count, seeds, header.bucket_count)) {
+            fprintf(stderr, "ERROR: vars_compile: Failed to build the perfect hash.\n");
+            ok = 0;
+        }
+    }
+
+    if (ok) {
+        vars_binary_entry* entries = (vars_binary_entry*)(out + entries_offset);
+        char* strings = out + strings_offset;
+        size_t cursor = 0;
+        for (uint32_t i = 0; i < count; i++) {
+            const vars_kv_pair* pair = &map->entries[indices[i]];
+            const vars_section* section = &map->sections[pair->section];
+            vars_binary_entry* entry = &entries[vars__binary_slot((const uint32_t*)(out + seeds_offset),
+                                                                  header.bucket_count, count, hashes[i])];
+            entry->hash = (uint32_t)hashes[i];
+            entry->key_offset = (uint32_t)cursor;
+            if (section->len) {
+                memcpy(strings + cursor, section->name, section->len);
+                cursor += section->len;
+                strings[cursor++] = '/';
+            }
+            memcpy(strings + cursor, pair->key, pair->key_len);
+            cursor += pair->key_len;
+            entry->key_len = (uint32_t)(cursor - entry->key_offset);
+            entry->value_offset = (uint32_t)cursor;
+            entry->value_len = pair->value_len;
+            memcpy(strings + cursor, pair->value, pair->value_len);
+            cursor += pair->value_len;
+            entry->typed = pair->typed;
+        }
+
+        // Programs that have the old file loaded keep reading their mapping.
+        if (!vars__write_file_atomic(dst, out, total, 1)) {
+            fprintf(stderr, "ERROR: vars_compile: Failed to write file: %s\n", dst);
+            ok = 0;
+        }
+    }
+
+    VARS_FREE(out);
+    VARS_FREE(indices);
+    VARS_FREE(hashes);
+    vars_free(text);
+    return ok;
+}
+
+// Checks that the tables the header points at lie inside the file. Entries
+// are checked when a lookup reaches them, so attaching stays O(1).
+static int vars__binary_attach(vars_file* file) {
+    const char* base = file->filebuf;
+    size_t size = file->filebuf_len;
+    vars_binary_header header;
+    if (size < sizeof(header)) return 0;
+    memcpy(&header, base, sizeof(header));
+
+    if (memcmp(header.magic, VARS_BINARY_MAGIC, 4) != 0) return 0;
+    if (header.version != VARS_BINARY_VERSION || header.entry_size != sizeof(vars_binary_entry)) return 0;
+    if (header.bucket_count == 0) return 0;
+    if (header.seeds_offset % 4 || header.entries_offset % 4) return 0;
+    if ((uint64_t)header.seeds_offset + (uint64_t)header.bucket_count * 4 > size) return 0;
+    if ((uint64_t)header.entries_offset + (uint64_t)header.count * sizeof(vars_binary_entry) > size) return 0;
+    if ((uint64_t)header.strings_offset + header.strings_size > size) return 0;
+
+    vars_binary* bin = (vars_binary*)VARS_MALLOC(sizeof(vars_binary));
+    if (!bin) return 0;
+    bin->seeds = (const uint32_t*)(base + header.seeds_offset);
+    bin->entries = (const vars_binary_entry*)(base + header.entries_offset);
+    bin->strings = base + header.strings_offset;
+    bin->strings_size = header.strings_size;
+    bin->count = header.count;
+    bin->bucket_count = header.bucket_count;
+    bin->generation = 1;
+    memset(&bin->usage, 0, sizeof(bin->usage));
+    file->binary = bin;
+    return 1;
+}
+
+static vars_file vars__load_binary_file(const char* file_path) {
+    vars_file file = {0};
+    if (!vars__map_file(file_path, &file)) exit(EXIT_FAILURE);
+    if (!vars__binary_attach(&file)) {
+        fprintf(stderr, "ERROR: vars_load_binary: Not a valid compiled vars file: %s\n", file_path);
+        exit(EXIT_FAILURE);
+    }
+    return file;
+}
+
+// ---------------------------------------------
+// HELPER FUNCTIONS
+// ---------------------------------------------
+
+// Compiled files have no pairs in memory, so their entries are copied into
+// scratch.
+static const vars_kv_pair* find_key_value(char* key, vars_file* file, vars_kv_pair* scratch) {
+    const vars_kv_pair* pair;
+    if (file->binary) {
+        pair = vars__binary_pair(file->binary, vars__binary_find(file->binary, key), scratch);
+        VARS_COUNT_LOOKUP(&file->binary->usage, pair);
+        return pair;
+    }
+    if (!file->map) return NULL;
+    pair = vars_map_find(file->map, key);
+    VARS_COUNT_LOOKUP(&file->map->usage, pair);
+    return pair;
+}
+
+// ---------------------------------------------
+// JOURNAL
+// ---------------------------------------------
+
+// After vars_journal_open(), every set is also appended to "<path>.journal"
+// and flushed to disk, so a durable write costs the size of the change rather
+// than the size of the file. Loading a text file replays its journal on top,
+// and vars_save() folds the journal into the file and empties it. A record is
+//
+//   <key length> <value length> <qualified key> <value>\n
+//
+// so values may hold anything, and a record cut short by a crash is dropped.
+
+#define VARS_JOURNAL_COMPACT_SIZE (64 * 1024) // Default size that triggers a vars_save().
+
+typedef struct vars_journal {
+    char* path;
+    int fd;
+    size_t size;
+    size_t compact_size;
+} vars_journal;
+
+static char* vars__journal_path(const char* file_path) {
+    size_t path_len = strlen(file_path);
+    char* path = (char*)VARS_MALLOC(path_len + 9);
+    if (!path) return NULL;
+    memcpy(path, file_path, path_len);
+    memcpy(path + path_len, ".journal", 9);
+    return path;
+}
+
+static int vars__journal_open_fd(const char* path, int truncate) {
+#ifdef _WIN32
+    return _open(path, _O_WRONLY | _O_CREAT | _O_APPEND | _O_BINARY | (truncate ? _O_TRUNC : 0), _S_IREAD | _S_IWRITE);
+#else
+    return open(path, O_WRONLY | O_CREAT | O_APPEND | (truncate ? O_TRUNC : 0), 0666);
+#endif
+}
+
+static void vars__journal_close(vars_journal* journal) {
+    if (!journal) return;
+#ifdef _WIN32
+    if (journal->fd >= 0) _close(journal->fd);
+#else
+    if (journal->fd >= 0) close(journal->fd);
+#endif
+    VARS_FREE(journal->path);
+    VARS_FREE(journal);
+}
+
+// Called once the file on disk holds everything the journal did.
+static void vars__journal_reset(vars_file* file) {
+    vars_journal* journal = file->journal;
+    if (!journal) {
+        // A journal replayed at load but never opened is stale now too.
+        char* path = vars__journal_path(file->file_path);
+        if (path) remove(path);
+        VARS_FREE(path);
+        return;
+    }
+#ifdef _WIN32
+    if (journal->fd >= 0) _close(journal->fd);
+#else
+    if (journal->fd >= 0) close(journal->fd);
+#endif
+    journal->fd = vars__journal_open_fd(journal->path, 1);
+    journal->size = 0;
+}
+
+// Appends one set to the journal, and compacts it once it has grown past
+// compact_size.
+static int vars__journal_append(vars_file* file, const char* key, const char* value, size_t value_len) {
+    vars_journal* journal = file->journal;
+    if (journal->fd < 0) return 0;
+
+    size_t key_len = strlen(key);
+    char header[48];
+    int header_len = snprintf(header, sizeof(header), "%zu %zu ", key_len, value_len);
+    size_t record_len = (size_t)header_len + key_len + 1 + value_len + 1;
+
+    // One write per record, so a crash can only cut off the last one.
+    char stack_record[256];
+    char* record = record_len <= sizeof(stack_record) ? stack_record : (char*)VARS_MALLOC(record_len);
+    if (!record) return 0;
+    char* cursor = record;
+    memcpy(cursor, header, (size_t)header_len);
+    cursor += header_len;
+    memcpy(cursor, key, key_len);
+    cursor += key_len;
+    *cursor++ = ' ';
+    memcpy(cursor, value, value_len);
+    cursor += value_len;
+    *cursor++ = '\n';
+
+    int ok = vars__write_and_sync(journal->fd, record, record_len);
+    if (record != stack_record) VARS_FREE(record);
+    if (!ok) return 0;
+
+    journal->size += record_len;
+    if (journal->size >= journal->compact_size) return vars_save(file);
+    return 1;
+}
+
+// ---------------------------------------------
+// KEY ORDER
+// ---------------------------------------------
+
+static int vars__compare_bytes(const char* a, size_t a_len, const char* b, size_t b_len) {
+    int cmp = memcmp(a, b, a_len < b_len ? a_len : b_len);
+    if (cmp != 0) return cmp;
+    return a_len < b_len ? -1 : a_len > b_len;
+}
+
+// The global section, which has no name, comes first.
+static int vars__section_compare(const void* a, const void* b) {
+    const vars_section* sa = *(const vars_section* const*)a;
+    const vars_section* sb = *(const vars_section* const*)b;
+    return vars__compare_bytes(sa->name, sa->len, sb->name, sb->len);
+}
+
+static int vars__pair_compare(const void* a, const void* b) {
+    const vars_kv_pair* pa = *(const vars_kv_pair* const*)a;
+    const vars_kv_pair* pb = *(const vars_kv_pair* const*)b;
+    return vars__compare_bytes(pa->key, pa->key_len, pb->key, pb->key_len);
+}
+
+// Brings map->order up to date. Pairs are bucketed by the rank of their
+// section and each bucket is sorted by key. Returns 0 if memory runs out.
+static int vars__order_update(vars_map* map) {
+    if (map->order.generation == map->generation) return 1;
+
+    uint32_t section_count = map->section_count;
+    vars_order order;
+    order.slots = (uint32_t*)VARS_MALLOC((map->count ? map->count : 1) * sizeof(uint32_t));
+    order.starts = (uint32_t*)vars__calloc(section_count + 1, sizeof(uint32_t));
+    order.sections = (uint32_t*)VARS_MALLOC(section_count * sizeof(uint32_t));
+    order.ranks = (uint32_t*)VARS_MALLOC(section_count * sizeof(uint32_t));
+    const vars_section** by_name = (const vars_section**)VARS_MALLOC(section_count * sizeof(vars_section*));
+    const vars_kv_pair** pairs = (const vars_kv_pair**)VARS_MALLOC((map->count ? map->count : 1) * sizeof(vars_kv_pair*));
+    if (!order.slots || !order.starts || !order.sections || !order.ranks || !by_name || !pairs) {
+        VARS_FREE(order.slots);
+        VARS_FREE(order.starts);
+        VARS_FREE(order.sections);
+        VARS_FREE(order.ranks);
+        VARS_FREE((void*)by_name);
+        VARS_FREE((void*)pairs);
+        return 0;
+    }
+
+    for (uint32_t i = 0; i < section_count; i++) by_name[i] = &map->sections[i];
+    qsort((void*)by_name, section_count, sizeof(vars_section*), vars__section_compare);
+    for (uint32_t rank = 0; rank < section_count; rank++) {
+        uint32_t index = (uint32_t)(by_name[rank] - map->sections);
+        order.sections[rank] = index;
+        order.ranks[index] = rank;
+    }
+
+    // Count each section's pairs, turn the counts into start positions, and
+    // place every pair. Placing moves each start to the next section's.
+    for (size_t i = 0; i < map->capacity; i++) {
+        if (VARS_CTRL_IS_FULL(map->ctrl[i])) order.starts[order.ranks[map->entries[i].section] + 1]++;
+    }
+    for (uint32_t rank = 0; rank < section_count; rank++) order.starts[rank + 1] += order.starts[rank];
+    for (size_t i = 0; i < map->capacity; i++) {
+        if (VARS_CTRL_IS_FULL(map->ctrl[i])) pairs[order.starts[order.ranks[map->entries[i].section]]++] = &map->entries[i];
+    }
+    for (uint32_t rank = section_count; rank > 0; rank--) order.starts[rank] = order.starts[rank - 1];
+    order.starts[0] = 0;
+
+    for (uint32_t rank = 0; rank < section_count; rank++) {
+        uint32_t first = order.starts[rank];
+        qsort((void*)(pairs + first), order.starts[rank + 1] - first, sizeof(vars_kv_pair*), vars__pair_compare);
+    }
+    for (size_t i = 0; i < map->count; i++) order.slots[i] = (uint32_t)(pairs[i] - map->entries);
+
+    VARS_FREE((void*)by_name);
+    VARS_FREE((void*)pairs);
+    VARS_FREE(map->order.slots);
+    VARS_FREE(map->order.starts);
+    VARS_FREE(map->order.sections);
+    VARS_FREE(map->order.ranks);
+    order.generation = map->generation;
+    map->order = order;
+    return 1;
+}
+
+// Compares only as much of name as prefix is long, so every name that starts
+// with prefix compares equal to it.
+static int vars__compare_prefix(const char* name, size_t name_len, const char* prefix, size_t prefix_len) {
+    return vars__compare_bytes(name, name_len < prefix_len ? name_len : prefix_len, prefix, prefix_len);
+}
+
+// Narrows the ranks [*first, *last) to the sections whose names start with
+// prefix. Ranks are in name order, so those are one run found by two binary searches.
+static void vars__order_section_range(const vars_map* map, const char* prefix, size_t len, uint32_t* first, uint32_t* last) {
+    for (int upper = 0; upper < 2; upper++) {
+        uint32_t low = *first, high = *last;
+        while (low < high) {
+            uint32_t mid = low + (high - low) / 2;
+            const vars_section* section = &map->sections[map->order.sections[mid]];
+            int cmp = vars__compare_prefix(section->name, section->len, prefix, len);
+            if (cmp < 0 || (upper && cmp == 0)) low = mid + 1;
+            else high = mid;
+        }
+        if (upper) *last = low;
+        else *first = low;
+    }
+}
+
+// The same for the keys in order.slots[*first, *last), which are in key order
+// within one section.
+static void vars__order_key_range(const vars_map* map, const char* prefix, size_t len, uint32_t* first, uint32_t* last) {
+    for (int upper = 0; upper < 2; upper++) {
+        uint32_t low = *first, high = *last;
+        while (low < high) {
+            uint32_t mid = low + (high - low) / 2;
+            const vars_kv_pair* pair = &map->entries[map->order.slots[mid]];
+            int cmp = vars__compare_prefix(pair->key, pair->key_len, prefix, len);
+            if (cmp < 0 || (upper && cmp == 0)) low = mid + 1;
+            else high = mid;
+        }
+        if (upper) *last = low;
+        else *first = low;
+    }
+}
+
+// ---------------------------------------------
+// SECTION ITERATORS
+// ---------------------------------------------
+
+#define VARS_ITER_ANY_KEY 0
+#define VARS_ITER_ONE_KEY 1
+#define VARS_ITER_GLOB_KEY 2
+
+// '*' matches any run of characters and '?' any one, but neither matches a
+// '/', so "enemies/*" doesn't reach into "enemies/goblin/boss".
+static int vars__glob_match(const char* pattern, size_t pattern_len, const char* text, size_t text_len) {
+    size_t p = 0, t = 0;
+    size_t star = SIZE_MAX, star_text = 0;
+    while (t < text_len) {
+        if (p < pattern_len && pattern[p] == '*') {
+            star = p++;
+            star_text = t;
+        } else if (p < pattern_len && (pattern[p] == '?' ? text[t] != '/' : pattern[p] == text[t])) {
+            p++;
+            t++;
+        } else if (star != SIZE_MAX && text[star_text] != '/') {
+            p = star + 1;
+            t = ++star_text;
+        } else {
+            return 0;
+        }
+    }
+    while (p < pattern_len && pattern[p] == '*') p++;
+    return p == pattern_len;
+}
+
+// Length of the part of a pattern before its first wildcard.
+static size_t vars__literal_prefix(const char* text, size_t len) {
+    size_t i = 0;
+    while (i < len && text[i] != '*' && text[i] != '?') i++;
+    return i;
+}
+
+static int vars__has_wildcard(const char* text, size_t len) {
+    return vars__literal_prefix(text, len) < len;
+}
+
+// Points the iterator at the keys of the section ranked rank that it wants.
+static void vars__iter_enter(vars_iter* iter, const vars_map* map, uint32_t rank) {
+    iter->position = map->order.starts[rank];
+    iter->end = map->order.starts[rank + 1];
+    if (iter->key_mode == VARS_ITER_ANY_KEY) return;
+
+    // A single key is a binary search in its section's range, and a glob only
+    // looks at the keys that start with its literal part.
+    size_t prefix_len = iter->key_pattern_len;
+    if (iter->key_mode == VARS_ITER_GLOB_KEY) prefix_len = vars__literal_prefix(iter->key_pattern, iter->key_pattern_len);
+    vars__order_key_range(map, iter->key_pattern, prefix_len, &iter->position, &iter->end);
+    if (iter->key_mode == VARS_ITER_ONE_KEY && iter->end > iter->position) {
+        // Shorter keys sort first, so the exact match, if any, leads the run.
+        const vars_kv_pair* pair = &map->entries[map->order.slots[iter->position]];
+        iter->end = pair->key_len == iter->key_pattern_len ? iter->position + 1 : iter->position;
+    }
+}
+
+static vars_iter vars__iter_begin(vars_file* file, const char* section, size_t section_len, int section_glob,
+                                  const char* key, size_t key_len, int key_mode) {
+    vars_iter iter;
+    memset(&iter, 0, sizeof(iter));
+    if (!file) return iter;
+    iter.file = file;
+    iter.section_pattern = section;
+    iter.section_pattern_len = section_len;
+    iter.section_glob = section_glob;
+    iter.key_pattern = key;
+    iter.key_pattern_len = key_len;
+    iter.key_mode = key_mode;
+
+    if (file->binary) {
+        iter.generation = file->binary->generation;
+        iter.end = file->binary->count;
+        return iter;
+    }
+    vars_map* map = file->map;
+    if (!map || !vars__order_update(map)) {
+        iter.file = NULL;
+        return iter;
+    }
+    iter.generation = map->generation;
+    if (section_glob) {
+        // vars_iter_next() walks the sections whose names start like the pattern.
+        iter.next_rank = 0;
+        iter.last_rank = map->section_count;
+        vars__order_section_range(map, section, vars__literal_prefix(section, section_len), &iter.next_rank, &iter.last_rank);
+        return iter;
+    }
+
+    uint32_t index = 0;
+    if (section_len) index = vars_map_find_section(map, section, section_len, hash_fnv1a(hash_fnv1a(VARS_FNV_OFFSET, section, section_len), "/", 1));
+    if (index != UINT32_MAX) vars__iter_enter(&iter, map, map->order.ranks[index]);
+    return iter;
+}
+
+static int vars__iter_key_matches(const vars_iter* iter, const char* key, size_t key_len) {
+    if (iter->key_mode == VARS_ITER_ANY_KEY) return 1;
+    if (iter->key_mode == VARS_ITER_ONE_KEY) return vars__compare_bytes(key, key_len, iter->key_pattern, iter->key_pattern_len) == 0;
+    return vars__glob_match(iter->key_pattern, iter->key_pattern_len, key, key_len);
+}
+
+// Compiled files store qualified keys and no section table, so their entries
+// are all checked, in table order.
+static int vars__iter_next_binary(vars_iter* iter) {
+    const vars_binary* bin = iter->file->binary;
+    while (iter->position < iter->end) {
+        const vars_binary_entry* entry = &bin->entries[iter->position++];
+        if ((uint64_t)entry->key_offset + entry->key_len > bin->strings_size) continue;
+        if ((uint64_t)entry->value_offset + entry->value_len > bin->strings_size) continue;
+
+        const char* name = bin->strings + entry->key_offset;
+        size_t split = entry->key_len;
+        while (split > 0 && name[split - 1] != '/') split--;
+        size_t section_len = split ? split - 1 : 0;
+
+        int section_matches = iter->section_glob
+            ? section_len && vars__glob_match(iter->section_pattern, iter->section_pattern_len, name, section_len)
+            : vars__compare_bytes(name, section_len, iter->section_pattern, iter->section_pattern_len) == 0;
+        if (!section_matches || !vars__iter_key_matches(iter, name + split, entry->key_len - split)) continue;
+
+        iter->section = name;
+        iter->section_len = section_len;
+        iter->key = name + split;
+        iter->key_len = entry->key_len - split;
+        iter->value = bin->strings + entry->value_offset;
+        iter->value_len = entry->value_len;
+        return 1;
+    }
+    return 0;
+}
+
+// Walks the keys of one section in key order. NULL or "" is the global
+// section. The iterator borrows file, which must not move while it is used.
+VARSAPI vars_iter vars_section_iter(vars_file* file, const char* section) {
+    if (!section) section = "";
+    return vars__iter_begin(file, section, strlen(section), 0, NULL, 0, VARS_ITER_ANY_KEY);
+}
+
+// Walks the keys matching pattern, e.g. "enemies/*/speed", by section name and
+// then by key. Everything before the last '/' is matched against section
+// names and the rest against keys, with the wildcards of vars__glob_match().
+// A pattern with no section part, like "speed", or an empty one, like
+// "/speed", looks in the global section. pattern is not copied and must
+// outlive the iterator.
+VARSAPI vars_iter vars_query(vars_file* file, const char* pattern) {
+    if (!pattern) pattern = "";
+    size_t len = strlen(pattern);
+    const char* slash = strrchr(pattern, '/');
+    size_t section_len = slash ? (size_t)(slash - pattern) : 0;
+    const char* key = slash ? slash + 1 : pattern;
+    size_t key_len = (size_t)(pattern + len - key);
+    int key_mode = vars__has_wildcard(key, key_len) ? VARS_ITER_GLOB_KEY : VARS_ITER_ONE_KEY;
+    return vars__iter_begin(file, pattern, section_len, vars__has_wildcard(pattern, section_len), key, key_len, key_mode);
+}
+
+// Moves to the next matching key and returns 1, or returns 0 once there are
+// none left. Adding or removing keys, or reloading the file, ends the walk.
+VARSAPI int vars_iter_next(vars_iter* iter) {
+    if (!iter || !iter->file) return 0;
+    if (iter->file->binary) {
+        if (iter->generation != iter->file->binary->generation) return 0;
+        return vars__iter_next_binary(iter);
+    }
+
+    const vars_map* map = iter->file->map;
+    if (!map || iter->generation != map->generation) return 0;
+    for (;;) {
+        while (iter->position < iter->end) {
+            const vars_kv_pair* pair = &map->entries[map->order.slots[iter->position++]];
+            if (iter->key_mode == VARS_ITER_GLOB_KEY && !vars__iter_key_matches(iter, pair->key, pair->key_len)) continue;
+
+            const vars_section* section = &map->sections[pair->section];
+            iter->section = section->name;
+            iter->section_len = section->len;
+            iter->key = pair->key;
+            iter->key_len = pair->key_len;
+            iter->value = pair->value;
+            iter->value_len = pair->value_len;
+            return 1;
+        }
+
+        // Only patterns with wildcards in the section span several sections.
+        while (iter->next_rank < iter->last_rank) {
+            uint32_t rank = iter->next_rank++;
+            const vars_section* section = &map->sections[map->order.sections[rank]];
+            if (section->len && vars__glob_match(iter->section_pattern, iter->section_pattern_len, section->name, section->len)) {
+                vars__iter_enter(iter, map, rank);
+                break;
+            }
+        }
+        if (iter->position >= iter->end && iter->next_rank >= iter->last_rank) return 0;
+    }
+}
+
+// ---------------------------------------------
+// SAVE FUNCTIONS
+// ---------------------------------------------
+
+// Writes the whole file into one buffer, sorted by section and key. The key
+// order is views into the map, so saving copies nothing but the output itself.
+// The ":include" lines go first, and the keys they brought in stay out.
+static char* vars__serialize(vars_map* map, size_t* out_len) {
+    if (!vars__order_update(map)) return NULL;
+
+    size_t size = 1;
+    for (uint32_t i = 0; i < map->includes.count; i++) size += map->includes.lines[i].len + 10;
+    for (uint32_t rank = 0; rank < map->section_count; rank++) {
+        uint32_t first = map->order.starts[rank], last = map->order.starts[rank + 1];
+        if (first == last) continue;
+        // Room for "\n:/section\n" before the section's keys.
+        size += map->sections[map->order.sections[rank]].len + 4;
+        for (uint32_t i = first; i < last; i++) {
+            const vars_kv_pair* pair = &map->entries[map->order.slots[i]];
+            size += pair->key_len + pair->value_len + 2;
+        }
+    }
+
+    char* out = (char*)VARS_MALLOC(size);
+    if (!out) return NULL;
+
+    char* cursor = out;
+    for (uint32_t i = 0; i < map->includes.count; i++) {
+        memcpy(cursor, ":include ", 9);
+        cursor += 9;
+        memcpy(cursor, map->includes.lines[i].path, map->includes.lines[i].len);
+        cursor += map->includes.lines[i].len;
+        *cursor++ = '\n';
+    }
+    for (uint32_t rank = 0; rank < map->section_count; rank++) {
+        uint32_t first = map->order.starts[rank], last = map->order.starts[rank + 1];
+        while (first < last && (map->entries[map->order.slots[first]].flags & VARS_PAIR_INCLUDED)) first++;
+        if (first == last) continue;
+
+        // Every named section starts with a blank line, except at the top.
+        const vars_section* section = &map->sections[map->order.sections[rank]];
+        if (section->len) {
+            if (cursor > out) *cursor++ = '\n';
+            *cursor++ = ':';
+            *cursor++ = '/';
+            memcpy(cursor, section->name, section->len);
+            cursor += section->len;
+            *cursor++ = '\n';
+        }
+
+        for (uint32_t i = first; i < last; i++) {
+            const vars_kv_pair* pair = &map->entries[map->order.slots[i]];
+            if (pair->flags & VARS_PAIR_INCLUDED) continue;
+            memcpy(cursor, pair->key, pair->key_len);
+            cursor += pair->key_len;
+            *cursor++ = ' ';
+            memcpy(cursor, pair->value, pair->value_len);
+            cursor += pair->value_len;
+            *cursor++ = '\n';
+        }
+    }
+    *cursor = '\0';
+
+    *out_len = (size_t)(cursor - out);
+    return out;
+}
+
+// Stores owned_value, a string from the file's pool, under key. The pool
+// string is given back if the key can't be added.
+static int vars__store_owned_value(char* key, char* owned_value, size_t value_len, vars_file* file) {
+    vars_key_ref ref;
+    vars__split_key(key, &ref);
+    vars_kv_pair* existing = vars_map_find_ref(file->map, &ref);
+    if (existing) {
+        if (existing->flags & VARS_PAIR_OWNS_VALUE) {
+            vars_pool_free(&file->map->pool, existing->value, existing->value_len + 1);
+        }
+        existing->value = owned_value;
+        existing->value_len = (uint32_t)value_len;
+        existing->flags |= VARS_PAIR_OWNS_VALUE;
+        existing->flags &= ~VARS_PAIR_INCLUDED; // Set here, so saved here.
+        vars__parse_value(existing->value, existing->value_len, &existing->typed);
+        return 1;
+    }
+
+    uint32_t section = vars_map_section(file->map, ref.section, ref.section_len, 1);
+    char* owned_key = section != UINT32_MAX && ref.key_len <= UINT16_MAX
+                    ? vars_pool_strndup(&file->map->pool, ref.key, ref.key_len) : NULL;
+    if (!owned_key || !vars_map_insert(file->map, section, owned_key, ref.key_len, owned_value, value_len,
+                                       VARS_PAIR_OWNS_KEY | VARS_PAIR_OWNS_VALUE)) {
+        if (owned_key) vars_pool_free(&file->map->pool, owned_key, ref.key_len + 1);
+        vars_pool_free(&file->map->pool, owned_value, value_len + 1);
+        return 0;
+    }
+    return 1;
+}
+
+// Like vars__store_owned_value, and also journals the set if the file has a
+// journal open.
+static int vars__set_owned_value(char* key, char* owned_value, size_t value_len, vars_file* file) {
+    if (!vars__store_owned_value(key, owned_value, value_len, file)) return 0;
+    if (file->journal) return vars__journal_append(file, key, owned_value, value_len);
+    return 1;
+}
+
+static int vars__set_value(char* key, const char* value, vars_file* file) {
+    if (!file || !file->map || file->storage == VARS_STORAGE_MERGED) return 0;
+    
+    size_t value_len = strlen(value);
+    if (value_len > UINT32_MAX) return 0;
+    char* owned_value = vars_pool_strndup(&file->map->pool, value, value_len);
+    if (!owned_value) return 0;
+    return vars__set_owned_value(key, owned_value, value_len, file);
+}
+
+VARSAPI int vars_set_string(char* key, const char* value, vars_file* file) {
+    if (!key || !value || !file || !file->map || file->storage == VARS_STORAGE_MERGED) return 0;
+    
+    // Format as quoted string, straight into the pool
+    size_t len = strlen(value);
+    if (len + 2 > UINT32_MAX) return 0;
+    char* quoted_value = vars_pool_alloc(&file->map->pool, len + 3); // +2 for quotes, +1 for null terminator
+    if (!quoted_value) return 0;
+    
+    quoted_value[0] = '"';
+    memcpy(quoted_value + 1, value, len);
+    quoted_value[len + 1] = '"';
+    quoted_value[len + 2] = '\0';
+    
+    return vars__set_owned_value(key, quoted_value, len + 2, file);
+}
+
+VARSAPI int vars_set_float(char* key, float value, vars_file* file) {
+    if (!key || !file) return 0;
+    
+    char buffer[VARS_FLOAT_CHARS];
+    vars__format_float(value, buffer);
+    return vars__set_value(key, buffer, file);
+}
+
+VARSAPI int vars_set_int(char* key, int value, vars_file* file) {
+    if (!key || !file) return 0;
+    
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%d", value);
+    return vars__set_value(key, buffer, file);
+}
+
+VARSAPI int vars_set_bool(char* key, int value, vars_file* file) {
+    if (!key || !file) return 0;
+    
+    return vars__set_value(key, value ? "true" : "false", file);
+}
+
+VARSAPI int vars_set_vec2(char* key, vars_vec2 value, vars_file* file) {
+    if (!key || !file) return 0;
+    
+    char buffer[2 * VARS_FLOAT_CHARS + 2];
+    vars__format_vec((const float*)&value, 2, buffer);
+    return vars__set_value(key, buffer, file);
 }
 
 VARSAPI int vars_set_vec3(char* key, vars_vec3 value, vars_file* file) {
     if (!key || !file) return 0;
     
-    char buffer[96];
-    snprintf(buffer, sizeof(buffer), "(%.6f %.6f %.6f)", value.x, value.y, value.z);
+    char buffer[3 * VARS_FLOAT_CHARS + 2];
+    vars__format_vec((const float*)&value, 3, buffer);
     return vars__set_value(key, buffer, file);
 }
 
 VARSAPI int vars_set_vec4(char* key, vars_vec4 value, vars_file* file) {
     if (!key || !file) return 0;
     
-    char buffer[128];
-    snprintf(buffer, sizeof(buffer), "(%.6f %.6f %.6f %.6f)", value.x, value.y, value.z, value.w);
+    char buffer[4 * VARS_FLOAT_CHARS + 2];
+    vars__format_vec((const float*)&value, 4, buffer);
     return vars__set_value(key, buffer, file);
 }
 
+// The file is replaced with a rename, so a crash or a full disk mid-save
+// leaves the old contents in place.
 VARSAPI int vars_save(vars_file* file) {
     if (!file || !file->file_path || !file->map) return 0;
     
-    // Create a list of all entries sorted by section and key
-    vars_entry_list list;
-    vars_entry_list_init(&list);
+    size_t len = 0;
+    char* out = vars__serialize(file->map, &len);
+    if (!out) return 0;
     
-    // Extract all entries from the hashmap
-    for (size_t i = 0; i < file->map->capacity; i++) {
-        if (file->map->entries[i].key) {
-            const char* full_key = file->map->entries[i].key;
-            const char* value = file->map->entries[i].value;
-            
-            // Split the key into section and key parts
-            const char* slash = strchr(full_key, '/');
-            if (slash) {
-                // Has section
-                size_t section_len = slash - full_key;
-                char* section = (char*)malloc(section_len + 1);
-                strncpy(section, full_key, section_len);
-                section[section_len] = '\0';
-                
-                vars_entry_list_add(&list, section, slash + 1, value);
-                free(section);
-            } else {
-                // No section (global)
-                vars_entry_list_add(&list, NULL, full_key, value);
-            }
-        }
+    int ok = vars__write_file_atomic(file->file_path, out, len, 0);
+    VARS_FREE(out);
+    
+    // Update the file's modification time
+    if (ok) {
+        file->last_modified = vars__get_file_mod_time(file->file_path);
+        vars__journal_reset(file);
     }
     
-    // Sort entries by section and key
-    qsort(list.entries, list.count, sizeof(vars_entry), vars_entry_compare);
+    return ok;
+}
+
+// Returns what vars_save() would write, without touching the disk, or NULL if
+// memory runs out. Free it with vars_free_memory().
+VARSAPI char* vars_save_to_memory(vars_file* file, size_t* out_len) {
+    if (!file || !file->map) return NULL;
     
-    // Write to file
-    FILE* fp = fopen(file->file_path, "w");
-    if (!fp) {
-        vars_entry_list_free(&list);
+    size_t len = 0;
+    char* out = vars__serialize(file->map, &len);
+    if (out && out_len) *out_len = len;
+    return out;
+}
+
+VARSAPI void vars_free_memory(void* memory) {
+    VARS_FREE(memory);
+}
+
+// Replaces the file at file_path with data the same way vars_save() does.
+// Together with vars_save_to_memory() this lets a worker thread do the disk
+// work. Files loaded from file_path see the change on their next vars_hot_load().
+VARSAPI int vars_write_file(const char* file_path, const char* data, size_t len) {
+    if (!file_path || !data) return 0;
+    return vars__write_file_atomic(file_path, data, len, 0);
+}
+
+// Reads a record's "<length> " prefix. Returns NULL if it isn't one.
+static const char* vars__journal_length(const char* cursor, const char* end, size_t* out) {
+    size_t value = 0;
+    const char* start = cursor;
+    while (cursor < end && IS_NUMBER(*cursor) && cursor - start < 10) {
+        value = value * 10 + (size_t)(*cursor++ - '0');
+    }
+    if (cursor == start || cursor >= end || *cursor != ' ') return NULL;
+    *out = value;
+    return cursor + 1;
+}
+
+// Applies the records in data to file, or only checks them if file is NULL.
+// Returns how many bytes at the start of data hold complete records.
+static size_t vars__journal_replay(vars_file* file, const char* data, size_t len) {
+    const char* cursor = data;
+    const char* end = data + len;
+    while (cursor < end) {
+        size_t key_len, value_len;
+        const char* key = vars__journal_length(cursor, end, &key_len);
+        if (key) key = vars__journal_length(key, end, &value_len);
+        if (!key || key_len == 0 || key_len > UINT16_MAX || value_len > UINT32_MAX) break;
+        if ((size_t)(end - key) < key_len + value_len + 2) break;
+        const char* value = key + key_len + 1;
+        if (key[key_len] != ' ' || value[value_len] != '\n') break;
+
+        if (file) {
+            char stack_key[256];
+            char* owned_key = key_len < sizeof(stack_key) ? stack_key : (char*)VARS_MALLOC(key_len + 1);
+            char* owned_value = vars_pool_strndup(&file->map->pool, value, value_len);
+            if (!owned_key || !owned_value) vars__out_of_memory();
+            memcpy(owned_key, key, key_len);
+            owned_key[key_len] = '\0';
+            if (!vars__store_owned_value(owned_key, owned_value, value_len, file)) vars__out_of_memory();
+            if (owned_key != stack_key) VARS_FREE(owned_key);
+        }
+        cursor = value + value_len + 1;
+    }
+    return (size_t)(cursor - data);
+}
+
+// Reads the journal of the text file at file_path, if it has one, and applies
+// it to file unless that is NULL. Returns 1 when the journal ended in a
+// record cut short by a crash.
+static int vars__journal_load(vars_file* file, const char* file_path, size_t* out_size) {
+    *out_size = 0;
+    char* path = vars__journal_path(file_path);
+    if (!path) vars__out_of_memory();
+    FILE* fp = fopen(path, "rb");
+    VARS_FREE(path);
+    if (!fp) return 0;
+
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    rewind(fp);
+    char* data = size > 0 ? (char*)VARS_MALLOC((size_t)size) : NULL;
+    size_t read = data ? fread(data, 1, (size_t)size, fp) : 0;
+    fclose(fp);
+
+    size_t valid = vars__journal_replay(file, data, read);
+    VARS_FREE(data);
+    *out_size = valid;
+    return valid != read;
+}
+
+// Starts journaling sets to "<path>.journal". The journal is folded into the
+// file by vars_save(), which also runs on its own once the journal reaches
+// compact_size bytes (0 picks VARS_JOURNAL_COMPACT_SIZE). Returns 1 on success
+// and 0 on failure.
+VARSAPI int vars_journal_open(vars_file* file, size_t compact_size) {
+    if (!file || !file->map || !file->file_path) return 0;
+    if (!compact_size) compact_size = VARS_JOURNAL_COMPACT_SIZE;
+    if (file->journal) {
+        file->journal->compact_size = compact_size;
+        return 1;
+    }
+
+    vars_journal* journal = (vars_journal*)vars__calloc(1, sizeof(vars_journal));
+    if (!journal) return 0;
+    journal->path = vars__journal_path(file->file_path);
+    journal->compact_size = compact_size;
+    journal->fd = journal->path ? vars__journal_open_fd(journal->path, 0) : -1;
+    if (journal->fd < 0) {
+        vars__journal_close(journal);
         return 0;
     }
-    
-    const char* current_section = NULL;
-    int wrote_section_header = 0;
-    
-    for (size_t i = 0; i < list.count; i++) {
-        vars_entry* entry = &list.entries[i];
-        
-        // Check if we need to make a subfolder
-        if (entry->section) {
-            if (!current_section || strcmp(current_section, entry->section) != 0) {
-                if (i > 0) fprintf(fp, "\n"); // Add blank line before new subfolder
-                fprintf(fp, ":/%s\n", entry->section);
-                current_section = entry->section;
-                wrote_section_header = 1;
+    file->journal = journal;
+
+    // The load already replayed the journal. Appending after a torn record
+    // would hide everything that follows it, so fold it in and start over.
+    if (vars__journal_load(NULL, file->file_path, &journal->size)) return vars_save(file);
+    return 1;
+}
+
+
+// ---------------------------------------------
+// CHANGE TRACKING
+// ---------------------------------------------
+
+#define VARS_PAIR_SEEN 0x4 // Only set while a reload is being applied.
+
+typedef struct {
+    char* filter; // NULL matches every key.
+    vars_change_callback callback;
+    void* user_data;
+} vars_listener;
+
+typedef struct vars_listeners {
+    vars_listener* items;
+    size_t count;
+    size_t capacity;
+} vars_listeners;
+
+typedef struct {
+    size_t key_offset;
+    vars_change change;
+} vars_change_record;
+
+typedef struct {
+    char* keys; // Qualified keys, each NUL terminated.
+    size_t keys_len;
+    size_t keys_capacity;
+    vars_change_record* records;
+    size_t count;
+    size_t capacity;
+} vars_change_list;
+
+static void vars__record_change(vars_change_list* list, const vars_map* map, const vars_kv_pair* pair, vars_change change) {
+    if (!list) return;
+    const vars_section* section = &map->sections[pair->section];
+    size_t len = (section->len ? section->len + 1 : 0) + pair->key_len + 1;
+
+    if (list->keys_len + len > list->keys_capacity) {
+        size_t capacity = list->keys_capacity ? list->keys_capacity * 2 : 256;
+        while (capacity < list->keys_len + len) capacity *= 2;
+        char* keys = (char*)VARS_REALLOC(list->keys, capacity);
+        if (!keys) vars__out_of_memory();
+        list->keys = keys;
+        list->keys_capacity = capacity;
+    }
+    if (list->count == list->capacity) {
+        size_t capacity = list->capacity ? list->capacity * 2 : 16;
+        vars_change_record* records = (vars_change_record*)VARS_REALLOC(list->records, capacity * sizeof(vars_change_record));
+        if (!records) vars__out_of_memory();
+        list->records = records;
+        list->capacity = capacity;
+    }
+
+    list->records[list->count].key_offset = list->keys_len;
+    list->records[list->count].change = change;
+    list->count++;
+
+    char* out = list->keys + list->keys_len;
+    if (section->len) {
+        memcpy(out, section->name, section->len);
+        out += section->len;
+        *out++ = '/';
+    }
+    memcpy(out, pair->key, pair->key_len);
+    out[pair->key_len] = '\0';
+    list->keys_len += len;
+}
+
+// A filter is a qualified key, or a section name ending in '/' that matches
+// the keys directly in that section.
+static int vars__filter_matches(const char* filter, const char* key) {
+    if (!filter) return 1;
+    size_t len = strlen(filter);
+    if (len && filter[len - 1] == '/') {
+        return strncmp(filter, key, len) == 0 && !strchr(key + len, '/');
+    }
+    return strcmp(filter, key) == 0;
+}
+
+static void vars__notify(vars_file* file, const vars_change_list* list) {
+    vars_listeners* listeners = file->listeners;
+    if (!listeners) return;
+    for (size_t i = 0; i < list->count; i++) {
+        const char* key = list->keys + list->records[i].key_offset;
+        for (size_t j = 0; j < listeners->count; j++) {
+            vars_listener* listener = &listeners->items[j];
+            if (vars__filter_matches(listener->filter, key)) {
+                listener->callback(file, key, list->records[i].change, listener->user_data);
+            }
+        }
+    }
+}
+
+static void vars__free_listeners(vars_listeners* listeners) {
+    if (!listeners) return;
+    for (size_t i = 0; i < listeners->count; i++) VARS_FREE(listeners->items[i].filter);
+    VARS_FREE(listeners->items);
+    VARS_FREE(listeners);
+}
+
+// Strings fresh owns, like values its journal replayed, live in its pool,
+// which goes away after the reload. map takes its own copy of those.
+static const char* vars__reload_string(vars_map* map, const char* str, size_t len, int fresh_owns) {
+    if (!fresh_owns) return str;
+    char* copy = vars_pool_strndup(&map->pool, str, len);
+    if (!copy) vars__out_of_memory();
+    return copy;
+}
+
+// Brings map in line with fresh, a new parse of the same file. Keys that are
+// still there keep their slot, and unchanged values keep their typed value,
+// so only added and removed keys bump the generation and handles survive
+// reloads that just edit values. Keys and values not owned by map are
+// repointed into fresh's buffer, since the old one is about to be released.
+// Owned values, from vars_set_*, are kept while the file agrees with them.
+static void vars__apply_reload(vars_map* map, vars_map* fresh, const char* old_buf, size_t old_len,
+                               vars_change_list* changes) {
+    uint32_t* section_map = (uint32_t*)VARS_MALLOC(fresh->section_count * sizeof(uint32_t));
+    if (!section_map) vars__out_of_memory();
+    for (uint32_t i = 0; i < fresh->section_count; i++) section_map[i] = UINT32_MAX;
+    section_map[0] = 0;
+
+    // Update the keys both parses have. Only the entry lookups find counts
+    // when the file repeats a key.
+    for (size_t i = 0; i < fresh->capacity; i++) {
+        if (!VARS_CTRL_IS_FULL(fresh->ctrl[i])) continue;
+        vars_kv_pair* pair = &fresh->entries[i];
+        const vars_section* section = &fresh->sections[pair->section];
+
+        vars_key_ref ref;
+        ref.hash = pair->hash;
+        ref.section = section->name;
+        ref.section_len = section->len;
+        ref.key = pair->key;
+        ref.key_len = pair->key_len;
+        if (vars_map_find_ref(fresh, &ref) != pair) continue;
+        pair->flags |= VARS_PAIR_SEEN;
+
+        vars_kv_pair* old = vars_map_find_ref(map, &ref);
+        if (!old) continue;
+        old->flags |= VARS_PAIR_SEEN;
+
+        vars_section* old_section = &map->sections[old->section];
+        if (!old_section->owned) {
+            old_section->name = vars__reload_string(map, section->name, section->len, section->owned);
+            old_section->owned = section->owned;
+        }
+        section_map[pair->section] = old->section;
+        old->flags = (uint16_t)((old->flags & ~VARS_PAIR_INCLUDED) | (pair->flags & VARS_PAIR_INCLUDED));
+        if (!(old->flags & VARS_PAIR_OWNS_KEY)) {
+            old->key = vars__reload_string(map, pair->key, pair->key_len, pair->flags & VARS_PAIR_OWNS_KEY);
+            old->flags |= pair->flags & VARS_PAIR_OWNS_KEY;
+        }
+
+        int fresh_owns_value = pair->flags & VARS_PAIR_OWNS_VALUE;
+        if (old->value_len == pair->value_len && memcmp(old->value, pair->value, pair->value_len) == 0) {
+            if (!(old->flags & VARS_PAIR_OWNS_VALUE)) {
+                old->value = vars__reload_string(map, pair->value, pair->value_len, fresh_owns_value);
+                old->flags |= fresh_owns_value;
             }
+            continue;
+        }
+        if (old->flags & VARS_PAIR_OWNS_VALUE) vars_pool_free(&map->pool, old->value, old->value_len + 1);
+        old->flags &= ~VARS_PAIR_OWNS_VALUE;
+        old->value = vars__reload_string(map, pair->value, pair->value_len, fresh_owns_value);
+        old->flags |= fresh_owns_value;
+        old->value_len = pair->value_len;
+        old->typed = pair->typed;
+        vars__record_change(changes, map, old, VARS_KEY_CHANGED);
+    }
+
+    // Drop what the file no longer has. Repeated keys that lookups never
+    // reached go without a report, so all reports are made before erasing.
+    for (size_t i = 0; changes && i < map->capacity; i++) {
+        if (!VARS_CTRL_IS_FULL(map->ctrl[i])) continue;
+        vars_kv_pair* pair = &map->entries[i];
+        if (pair->flags & VARS_PAIR_SEEN) continue;
+
+        const vars_section* section = &map->sections[pair->section];
+        vars_key_ref ref;
+        ref.hash = pair->hash;
+        ref.section = section->name;
+        ref.section_len = section->len;
+        ref.key = pair->key;
+        ref.key_len = pair->key_len;
+        if (vars_map_find_ref(map, &ref) == pair) vars__record_change(changes, map, pair, VARS_KEY_REMOVED);
+    }
+    for (size_t i = 0; i < map->capacity; i++) {
+        if (!VARS_CTRL_IS_FULL(map->ctrl[i])) continue;
+        vars_kv_pair* pair = &map->entries[i];
+        if (pair->flags & VARS_PAIR_SEEN) {
+            pair->flags &= ~VARS_PAIR_SEEN;
         } else {
-            // Global section
-            if (current_section) {
-                if (i > 0) fprintf(fp, "\n"); // Add blank line before global section
-                current_section = NULL;
-                wrote_section_header = 0;
+            vars_map_erase(map, pair);
+        }
+    }
+
+    // Add the new keys. Their typed values come straight from fresh.
+    for (size_t i = 0; i < fresh->capacity; i++) {
+        if (!VARS_CTRL_IS_FULL(fresh->ctrl[i])) continue;
+        vars_kv_pair pair = fresh->entries[i];
+        if (!(pair.flags & VARS_PAIR_SEEN)) continue;
+        pair.flags &= VARS_PAIR_OWNS_KEY | VARS_PAIR_OWNS_VALUE | VARS_PAIR_INCLUDED;
+
+        const vars_section* section = &fresh->sections[pair.section];
+        vars_key_ref ref;
+        ref.hash = pair.hash;
+        ref.section = section->name;
+        ref.section_len = section->len;
+        ref.key = pair.key;
+        ref.key_len = pair.key_len;
+        if (vars_map_find_ref(map, &ref)) continue;
+
+        if (section_map[pair.section] == UINT32_MAX) {
+            uint32_t index = vars_map_section(map, section->name, section->len, 0);
+            if (index == UINT32_MAX) vars__out_of_memory();
+            vars_section* added_section = &map->sections[index];
+            if (!added_section->owned) {
+                added_section->name = vars__reload_string(map, section->name, section->len, section->owned);
+                added_section->owned = section->owned;
             }
+            section_map[pair.section] = index;
         }
-        
-        // Write key-value pair
-        fprintf(fp, "%s %s\n", entry->key, entry->value);
+        pair.section = section_map[pair.section];
+        pair.key = vars__reload_string(map, pair.key, pair.key_len, pair.flags & VARS_PAIR_OWNS_KEY);
+        pair.value = vars__reload_string(map, pair.value, pair.value_len, pair.flags & VARS_PAIR_OWNS_VALUE);
+
+        if (!vars_map_reserve(map)) vars__out_of_memory();
+        vars_kv_pair* added = vars_map_place(map, &pair);
+        map->generation++;
+        vars__record_change(changes, map, added, VARS_KEY_ADDED);
     }
-    
-    fclose(fp);
-    vars_entry_list_free(&list);
-    
-    // Update the file's modification time
-    file->last_modified = vars__get_file_mod_time(file->file_path);
-    
+
+    // Sections the new file doesn't mention still have names in the old buffer.
+    for (uint32_t i = 1; i < map->section_count; i++) {
+        vars_section* section = &map->sections[i];
+        if (section->owned || section->name < old_buf || section->name >= old_buf + old_len) continue;
+        section->name = vars_pool_strndup(&map->pool, section->name, section->len);
+        if (!section->name) vars__out_of_memory();
+        section->owned = 1;
+    }
+
+    VARS_FREE(section_map);
+}
+
+// Registers a callback for vars_hot_load(). filter is a qualified key like
+// "game/speed", a section like "game/" or NULL for every key. Returns 1 on
+// success and 0 on failure.
+VARSAPI int vars_on_change(vars_file* file, const char* filter, vars_change_callback callback, void* user_data) {
+    if (!file || !callback) return 0;
+
+    if (!file->listeners) {
+        file->listeners = (vars_listeners*)vars__calloc(1, sizeof(vars_listeners));
+        if (!file->listeners) return 0;
+    }
+    vars_listeners* listeners = file->listeners;
+    if (listeners->count == listeners->capacity) {
+        size_t capacity = listeners->capacity ? listeners->capacity * 2 : 4;
+        vars_listener* items = (vars_listener*)VARS_REALLOC(listeners->items, capacity * sizeof(vars_listener));
+        if (!items) return 0;
+        listeners->items = items;
+        listeners->capacity = capacity;
+    }
+
+    vars_listener* listener = &listeners->items[listeners->count];
+    listener->filter = NULL;
+    if (filter) {
+        listener->filter = vars__strndup(filter, strlen(filter));
+        if (!listener->filter) return 0;
+    }
+    listener->callback = callback;
+    listener->user_data = user_data;
+    listeners->count++;
     return 1;
 }
 
@@ -544,36 +3946,69 @@ VARSAPI int vars_hot_load(vars_file* file) {
         return 0; // No file to reload
     }
 
-    long current_mod_time = vars__get_file_mod_time(file->file_path);
+    int64_t current_mod_time = vars__get_file_mod_time(file->file_path);
     if (current_mod_time == -1) {
         return 0; // Failed to get modification time
     }
 
-    if (current_mod_time <= file->last_modified) {
+    // Any difference counts, so restoring an older copy reloads too.
+    if (current_mod_time == file->last_modified && !(file->map && vars__includes_stale(file->map))) {
         return 0; // File hasn't changed
     }
 
-    // File has changed, reload it
-    vars_file new_file = vars__load_and_parse_file(file->file_path);
-    
-    // Copy file path and update modification time
-    size_t path_len = strlen(file->file_path);
-    new_file.file_path = (char*)malloc(path_len + 1);
-    if (!new_file.file_path) {
-        fprintf(stderr, "ERROR: vars_hot_load: Memory allocation failed.\n");
-        vars_free(new_file);
-        return 0;
+    double started = vars__now();
+
+    // Text files are diffed against the new parse and updated in place.
+    if (file->map) {
+        // A file caught halfway through a save, or an include that went
+        // missing, leaves the loaded keys in place until the next reload.
+        vars_file fresh;
+        if (!vars__parse_file(file->file_path, file->storage, &fresh)) return 0;
+        size_t journal_size;
+        vars__journal_load(&fresh, file->file_path, &journal_size);
+        vars_change_list changes;
+        memset(&changes, 0, sizeof(changes));
+        vars__apply_reload(file->map, fresh.map, file->filebuf, file->filebuf_len, file->listeners ? &changes : NULL);
+
+        // The map now points into the new includes, and the old ones go with fresh.
+        vars_include_list includes = file->map->includes;
+        file->map->includes = fresh.map->includes;
+        fresh.map->includes = includes;
+        vars__release_includes(fresh.map);
+
+        vars__release_buffer(file);
+        file->filebuf = fresh.filebuf;
+        file->filebuf_len = fresh.filebuf_len;
+        file->storage = fresh.storage;
+        file->last_modified = current_mod_time;
+        vars_map_free(fresh.map);
+        VARS_FREE(fresh.map);
+        file->map->usage.reload_seconds = vars__now() - started;
+
+        vars__notify(file, &changes);
+        VARS_FREE(changes.keys);
+        VARS_FREE(changes.records);
+        return 1;
     }
-    strcpy(new_file.file_path, file->file_path);
+
+    // Compiled files are swapped out whole
+    vars_file new_file = vars__load_binary_file(file->file_path);
+    
+    // The path and listeners carry over to the new data
+    new_file.file_path = file->file_path;
     new_file.last_modified = current_mod_time;
+    new_file.listeners = file->listeners;
 
-    // Free old buffers and hashmap
-    if (file->filebuf) free(file->filebuf);
-    if (file->parsed_buf) free(file->parsed_buf);
-    if (file->map) {
-        vars_map_free(file->map);
-        free(file->map);
+    // Handles resolved against the old table must notice that it is gone.
+    if (file->binary) {
+        new_file.binary->generation = file->binary->generation + 1;
+        new_file.binary->usage = file->binary->usage;
     }
+    new_file.binary->usage.reload_seconds = vars__now() - started;
+
+    // Free old buffers
+    vars__release_buffer(file);
+    VARS_FREE(file->binary);
 
     // Replace with new data
     *file = new_file;
@@ -581,12 +4016,160 @@ VARSAPI int vars_hot_load(vars_file* file) {
     return 1; // Successfully reloaded
 }
 
-VARSAPI char* vars_get_string(char* key, vars_file* file, char* buffer) {
-    const char* val = find_key_value(key, file);
-    if (!val || *val != '"') return NULL;
-    val++;
+// ---------------------------------------------
+// FILE WATCHING
+// ---------------------------------------------
+
+// On Linux the watcher asks inotify about the directories of the registered
+// files, so a poll with nothing new is a single read() that fails with EAGAIN,
+// however many files there are. Directories are watched rather than the files
+// because editors often save by writing a new file and renaming it over the
+// old one. Elsewhere, or if inotify can't be set up, every poll compares each
+// file's modification time with the one it was loaded with.
+
+typedef struct {
+    vars_file* file;
+    int wd; // inotify watch on the file's directory, or -1
+    int pending;
+} vars_watch_entry;
+
+struct vars_watcher {
+    int fd; // inotify instance, or -1 to poll with stat()
+    vars_watch_entry* entries;
+    size_t count;
+    size_t capacity;
+};
+
+#ifdef VARS_USE_INOTIFY
+static const char* vars__base_name(const char* path) {
+    const char* name = path;
+    for (const char* cursor = path; *cursor; cursor++) {
+        if (*cursor == '/' || *cursor == '\\') name = cursor + 1;
+    }
+    return name;
+}
+#endif
+
+VARSAPI vars_watcher* vars_watch_create(void) {
+    vars_watcher* watcher = (vars_watcher*)vars__calloc(1, sizeof(vars_watcher));
+    if (!watcher) return NULL;
+    watcher->fd = -1;
+#ifdef VARS_USE_INOTIFY
+    watcher->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+    return watcher;
+}
+
+// Starts watching a loaded file. The vars_file must stay at the same address
+// until it is removed or the watcher is freed. Returns 1 on success and 0 on failure.
+VARSAPI int vars_watch_add(vars_watcher* watcher, vars_file* file) {
+    if (!watcher || !file || !file->file_path) return 0;
+
+    if (watcher->count == watcher->capacity) {
+        size_t capacity = watcher->capacity ? watcher->capacity * 2 : 8;
+        vars_watch_entry* entries = (vars_watch_entry*)VARS_REALLOC(watcher->entries, capacity * sizeof(vars_watch_entry));
+        if (!entries) return 0;
+        watcher->entries = entries;
+        watcher->capacity = capacity;
+    }
+
+    vars_watch_entry* entry = &watcher->entries[watcher->count];
+    entry->file = file;
+    entry->wd = -1;
+    entry->pending = 0;
+
+#ifdef VARS_USE_INOTIFY
+    if (watcher->fd >= 0) {
+        size_t dir_len = (size_t)(vars__base_name(file->file_path) - file->file_path);
+        char* dir = dir_len ? vars__strndup(file->file_path, dir_len) : vars__strndup(".", 1);
+        if (!dir) return 0;
+        // Adding the same directory twice returns the same watch. No IN_CREATE:
+        // it fires while a recreated file is still empty, and the finished write
+        // or rename shows up as IN_CLOSE_WRITE or IN_MOVED_TO anyway.
+        entry->wd = inotify_add_watch(watcher->fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO | IN_ATTRIB);
+        VARS_FREE(dir);
+    }
+#endif
+
+    watcher->count++;
+    return 1;
+}
+
+VARSAPI int vars_watch_remove(vars_watcher* watcher, vars_file* file) {
+    if (!watcher || !file) return 0;
+    for (size_t i = 0; i < watcher->count; i++) {
+        if (watcher->entries[i].file != file) continue;
+#ifdef VARS_USE_INOTIFY
+        int wd = watcher->entries[i].wd;
+        int shared = 0;
+        for (size_t j = 0; j < watcher->count; j++) shared |= j != i && watcher->entries[j].wd == wd;
+        if (wd >= 0 && !shared) inotify_rm_watch(watcher->fd, wd);
+#endif
+        watcher->entries[i] = watcher->entries[--watcher->count];
+        return 1;
+    }
+    return 0;
+}
+
+// Fills changed with up to max files that were modified since they were
+// loaded and returns how many there are. Pass each one to vars_hot_load().
+// Files that don't fit are returned by the next poll.
+VARSAPI size_t vars_watch_poll(vars_watcher* watcher, vars_file** changed, size_t max) {
+    if (!watcher) return 0;
+
+    int overflowed = 0; // Events were dropped, so any watched file may have changed.
+#ifdef VARS_USE_INOTIFY
+    if (watcher->fd >= 0) {
+        char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+        for (;;) {
+            ssize_t len = read(watcher->fd, events, sizeof(events));
+            if (len <= 0) break;
+            for (char* cursor = events; cursor < events + len;) {
+                const struct inotify_event* event = (const struct inotify_event*)cursor;
+                if (event->mask & IN_Q_OVERFLOW) overflowed = 1;
+                for (size_t i = 0; event->len && i < watcher->count; i++) {
+                    vars_watch_entry* entry = &watcher->entries[i];
+                    if (entry->wd == event->wd && strcmp(vars__base_name(entry->file->file_path), event->name) == 0) {
+                        entry->pending = 1;
+                    }
+                }
+                cursor += sizeof(struct inotify_event) + event->len;
+            }
+        }
+    }
+#endif
+
+    size_t count = 0;
+    for (size_t i = 0; i < watcher->count; i++) {
+        vars_watch_entry* entry = &watcher->entries[i];
+        if (entry->wd < 0 || overflowed) {
+            int64_t mod_time = vars__get_file_mod_time(entry->file->file_path);
+            int modified = mod_time != -1 && mod_time != entry->file->last_modified;
+            entry->pending = modified || (entry->wd >= 0 && entry->pending);
+        }
+        if (entry->pending && count < max) {
+            changed[count++] = entry->file;
+            entry->pending = 0;
+        }
+    }
+    return count;
+}
+
+VARSAPI void vars_watch_free(vars_watcher* watcher) {
+    if (!watcher) return;
+#ifdef VARS_USE_INOTIFY
+    if (watcher->fd >= 0) close(watcher->fd);
+#endif
+    VARS_FREE(watcher->entries);
+    VARS_FREE(watcher);
+}
+
+static char* vars__value_to_string(const vars_kv_pair* pair, char* buffer) {
+    if (!pair || pair->typed.type != VARS_TYPE_STRING) return NULL;
+    const char* val = pair->value + 1;
+    size_t len = pair->value_len - 1;
     size_t i = 0;
-    while (val[i] && val[i] != '"') {
+    while (i < len && val[i] != '"') {
         buffer[i] = val[i];
         i++;
     }
@@ -594,62 +4177,312 @@ VARSAPI char* vars_get_string(char* key, vars_file* file, char* buffer) {
     return buffer;
 }
 
-VARSAPI float vars_get_float(char* key, vars_file* file) {
-    const char* val = find_key_value(key, file);
-    if (!val) return 0.0f;
-    return strtof(val, NULL);
+static float vars__value_to_float(const vars_kv_pair* pair) {
+    if (!pair || pair->typed.type == VARS_TYPE_VEC) return 0.0f;
+    return pair->typed.f[0];
 }
 
-VARSAPI int vars_get_int(char* key, vars_file* file) {
-    const char* val = find_key_value(key, file);
-    if (!val) return INT_MIN;
-    return (int)strtol(val, NULL, 10);
+static int vars__value_to_int(const vars_kv_pair* pair) {
+    if (!pair) return INT_MIN;
+    return pair->typed.i;
 }
 
-VARSAPI int vars_get_bool(char* key, vars_file* file) {
-    const char* val = find_key_value(key, file);
-    if (!val) return 0;
-    return (strcmp(val, "true") == 0) ? 1 : 0;
+static int vars__value_to_bool(const vars_kv_pair* pair) {
+    if (!pair) return 0;
+    return pair->typed.is_true;
 }
 
-VARSAPI vars_vec2 vars_get_vec2(char* key, vars_file* file) {
+static void vars__value_to_vec(const vars_kv_pair* pair, float* out, int count) {
+    if (!pair) return;
+    if (count > pair->typed.count) count = pair->typed.count;
+    for (int i = 0; i < count; i++) out[i] = pair->typed.f[i];
+}
+
+static vars_vec2 vars__value_to_vec2(const vars_kv_pair* pair) {
     vars_vec2 v = {0};
-    const char* val = find_key_value(key, file);
-    if (val) parse_vec(val, (float*)&v, 2);
+    vars__value_to_vec(pair, (float*)&v, 2);
     return v;
 }
 
-VARSAPI vars_vec3 vars_get_vec3(char* key, vars_file* file) {
+static vars_vec3 vars__value_to_vec3(const vars_kv_pair* pair) {
     vars_vec3 v = {0};
-    const char* val = find_key_value(key, file);
-    if (val) parse_vec(val, (float*)&v, 3);
+    vars__value_to_vec(pair, (float*)&v, 3);
     return v;
 }
 
-VARSAPI vars_vec4 vars_get_vec4(char* key, vars_file* file) {
+static vars_vec4 vars__value_to_vec4(const vars_kv_pair* pair) {
     vars_vec4 v = {0};
-    const char* val = find_key_value(key, file);
-    if (val) parse_vec(val, (float*)&v, 4);
+    vars__value_to_vec(pair, (float*)&v, 4);
     return v;
 }
 
+VARSAPI char* vars_get_string(char* key, vars_file* file, char* buffer) {
+    vars_kv_pair scratch;
+    return vars__value_to_string(find_key_value(key, file, &scratch), buffer);
+}
+
+VARSAPI float vars_get_float(char* key, vars_file* file) {
+    vars_kv_pair scratch;
+    return vars__value_to_float(find_key_value(key, file, &scratch));
+}
+
+VARSAPI int vars_get_int(char* key, vars_file* file) {
+    vars_kv_pair scratch;
+    return vars__value_to_int(find_key_value(key, file, &scratch));
+}
+
+VARSAPI int vars_get_bool(char* key, vars_file* file) {
+    vars_kv_pair scratch;
+    return vars__value_to_bool(find_key_value(key, file, &scratch));
+}
+
+VARSAPI vars_vec2 vars_get_vec2(char* key, vars_file* file) {
+    vars_kv_pair scratch;
+    return vars__value_to_vec2(find_key_value(key, file, &scratch));
+}
+
+VARSAPI vars_vec3 vars_get_vec3(char* key, vars_file* file) {
+    vars_kv_pair scratch;
+    return vars__value_to_vec3(find_key_value(key, file, &scratch));
+}
+
+VARSAPI vars_vec4 vars_get_vec4(char* key, vars_file* file) {
+    vars_kv_pair scratch;
+    return vars__value_to_vec4(find_key_value(key, file, &scratch));
+}
+
+// ---------------------------------------------
+// BATCHED GETS
+// ---------------------------------------------
+
+// Keys hashed and prefetched ahead of the lookups in vars_get_many().
+#ifndef VARS_GET_MANY_BATCH
+#define VARS_GET_MANY_BATCH 16
+#endif
+
+static void vars__value_to_result(const vars_kv_pair* pair, vars_get_type type, vars_result* out) {
+    switch (type) {
+    case VARS_GET_STRING: out->string = out->string ? vars__value_to_string(pair, out->string) : NULL; break;
+    case VARS_GET_FLOAT: out->f = vars__value_to_float(pair); break;
+    case VARS_GET_INT: out->i = vars__value_to_int(pair); break;
+    case VARS_GET_BOOL: out->b = vars__value_to_bool(pair); break;
+    case VARS_GET_VEC2: out->vec2 = vars__value_to_vec2(pair); break;
+    case VARS_GET_VEC3: out->vec3 = vars__value_to_vec3(pair); break;
+    case VARS_GET_VEC4: out->vec4 = vars__value_to_vec4(pair); break;
+    }
+}
+
+// Reads count keys at once, each as types[i] into out[i], with what the
+// matching vars_get_*() would return. Returns how many keys were found.
+// A batch of keys is hashed and the control bytes of their home groups
+// prefetched, then the entries whose tags match are prefetched, and only then
+// is any key probed, so the cache misses of a batch overlap instead of being
+// paid one after another. A group's entries span several cache lines, so
+// prefetching just the matching ones keeps the number in flight small.
+VARSAPI size_t vars_get_many(vars_file* file, const char* const* keys, const vars_get_type* types, vars_result* out, size_t count) {
+    if (!file || (!keys && count)) return 0;
+    size_t found = 0;
+
+    if (!file->map) {
+        // Compiled files are already one probe per key.
+        for (size_t i = 0; i < count; i++) {
+            vars_kv_pair scratch;
+            const vars_kv_pair* pair = find_key_value((char*)keys[i], file, &scratch);
+            vars__value_to_result(pair, types[i], &out[i]);
+            found += pair != NULL;
+        }
+        return found;
+    }
+
+    vars_map* map = file->map;
+    vars_key_ref refs[VARS_GET_MANY_BATCH];
+    for (size_t first = 0; first < count; first += VARS_GET_MANY_BATCH) {
+        size_t batch = count - first < VARS_GET_MANY_BATCH ? count - first : VARS_GET_MANY_BATCH;
+        for (size_t i = 0; i < batch; i++) {
+            vars__split_key(keys[first + i], &refs[i]);
+            if (map->capacity) VARS_PREFETCH(map->ctrl + vars_map_home_group(map, refs[i].hash));
+        }
+        for (size_t i = 0; map->capacity && i < batch; i++) {
+            size_t pos = vars_map_home_group(map, refs[i].hash);
+            uint32_t matches = vars_group_match(map->ctrl + pos, VARS_HASH_TAG(refs[i].hash));
+            for (; matches; matches &= matches - 1) VARS_PREFETCH(&map->entries[pos + (size_t)vars__ctz(matches)]);
+        }
+        for (size_t i = 0; i < batch; i++) {
+            const vars_kv_pair* pair = vars_map_find_ref(map, &refs[i]);
+            VARS_COUNT_LOOKUP(&map->usage, pair);
+            vars__value_to_result(pair, types[first + i], &out[first + i]);
+            found += pair != NULL;
+        }
+    }
+    return found;
+}
+
+// ---------------------------------------------
+// HANDLES
+// ---------------------------------------------
+
+#define VARS_INVALID_SLOT UINT32_MAX
+
+VARSAPI vars_handle vars_resolve(const char* key, vars_file* file) {
+    vars_handle handle;
+    handle.key = key;
+    handle.slot = VARS_INVALID_SLOT;
+    handle.generation = 0;
+    if (!key || !file) return handle;
+
+    if (file->binary) {
+        handle.generation = file->binary->generation;
+        handle.slot = vars__binary_find(file->binary, key);
+        return handle;
+    }
+    if (!file->map) return handle;
+
+    handle.generation = file->map->generation;
+    vars_kv_pair* pair = vars_map_find(file->map, key);
+    if (pair) handle.slot = (uint32_t)(pair - file->map->entries);
+    return handle;
+}
+
+static const vars_kv_pair* vars__handle_value(vars_handle* handle, vars_file* file, vars_kv_pair* scratch) {
+    if (!handle || !handle->key || !file) return NULL;
+    if (file->binary) {
+        if (handle->generation != file->binary->generation) *handle = vars_resolve(handle->key, file);
+        VARS_COUNT_LOOKUP(&file->binary->usage, handle->slot != VARS_INVALID_SLOT);
+        return vars__binary_pair(file->binary, handle->slot, scratch);
+    }
+    if (!file->map) return NULL;
+    if (handle->generation != file->map->generation) {
+        *handle = vars_resolve(handle->key, file);
+    }
+    VARS_COUNT_LOOKUP(&file->map->usage, handle->slot != VARS_INVALID_SLOT);
+    if (handle->slot == VARS_INVALID_SLOT) return NULL;
+    return &file->map->entries[handle->slot];
+}
+
+VARSAPI char* vars_get_string_h(vars_handle* handle, vars_file* file, char* buffer) {
+    vars_kv_pair scratch;
+    return vars__value_to_string(vars__handle_value(handle, file, &scratch), buffer);
+}
+
+VARSAPI float vars_get_float_h(vars_handle* handle, vars_file* file) {
+    vars_kv_pair scratch;
+    return vars__value_to_float(vars__handle_value(handle, file, &scratch));
+}
+
+VARSAPI int vars_get_int_h(vars_handle* handle, vars_file* file) {
+    vars_kv_pair scratch;
+    return vars__value_to_int(vars__handle_value(handle, file, &scratch));
+}
+
+VARSAPI int vars_get_bool_h(vars_handle* handle, vars_file* file) {
+    vars_kv_pair scratch;
+    return vars__value_to_bool(vars__handle_value(handle, file, &scratch));
+}
+
+VARSAPI vars_vec2 vars_get_vec2_h(vars_handle* handle, vars_file* file) {
+    vars_kv_pair scratch;
+    return vars__value_to_vec2(vars__handle_value(handle, file, &scratch));
+}
+
+VARSAPI vars_vec3 vars_get_vec3_h(vars_handle* handle, vars_file* file) {
+    vars_kv_pair scratch;
+    return vars__value_to_vec3(vars__handle_value(handle, file, &scratch));
+}
+
+VARSAPI vars_vec4 vars_get_vec4_h(vars_handle* handle, vars_file* file) {
+    vars_kv_pair scratch;
+    return vars__value_to_vec4(vars__handle_value(handle, file, &scratch));
+}
+
+// Reports what a loaded file holds and costs. The table is walked once, so
+// this is meant for profiling, not for every frame.
+VARSAPI int vars_get_stats(vars_file* file, vars_stats* stats) {
+    if (!file || !stats) return 0;
+    memset(stats, 0, sizeof(*stats));
+    stats->file_bytes = file->filebuf_len;
+
+    const vars_usage* usage = NULL;
+    if (file->binary) {
+        const vars_binary* bin = file->binary;
+        usage = &bin->usage;
+        stats->entries = bin->count;
+        stats->capacity = bin->count;
+        stats->load_factor = bin->count ? 1.0f : 0.0f;
+        stats->average_probe = bin->count ? 1.0f : 0.0f;
+        stats->max_probe = bin->count ? 1 : 0;
+        for (uint32_t i = 0; i < bin->count; i++) {
+            stats->key_bytes += bin->entries[i].key_len;
+            stats->value_bytes += bin->entries[i].value_len;
+        }
+    } else if (file->map) {
+        const vars_map* map = file->map;
+        usage = &map->usage;
+        stats->entries = map->count;
+        stats->sections = map->section_count - 1; // Not counting the global one.
+        stats->capacity = map->capacity;
+        stats->tombstones = map->deleted;
+        stats->load_factor = map->capacity ? (float)(map->count + map->deleted) / (float)map->capacity : 0.0f;
+        stats->table_bytes = map->capacity * (1 + sizeof(vars_kv_pair)) + map->section_capacity * (sizeof(vars_section) + 2 * sizeof(uint32_t));
+
+        // A lookup walks groups from the key's home group to the one it sits in.
+        size_t total_probe = 0;
+        for (size_t i = 0; i < map->capacity; i++) {
+            if (!VARS_CTRL_IS_FULL(map->ctrl[i])) continue;
+            const vars_kv_pair* pair = &map->entries[i];
+            size_t group = i & ~(size_t)(VARS_GROUP_SIZE - 1);
+            size_t probe = ((group - vars_map_home_group(map, pair->hash)) & map->mask) / VARS_GROUP_SIZE + 1;
+            total_probe += probe;
+            if (probe > stats->max_probe) stats->max_probe = probe;
+            stats->key_bytes += pair->key_len;
+            stats->value_bytes += pair->value_len;
+            if ((pair->flags & VARS_PAIR_OWNS_KEY) && pair->key_len + 1 > VARS_POOL_MAX_CLASS) stats->owned_bytes += pair->key_len + 1;
+            if ((pair->flags & VARS_PAIR_OWNS_VALUE) && pair->value_len + 1 > VARS_POOL_MAX_CLASS) stats->owned_bytes += pair->value_len + 1;
+        }
+        if (map->count) stats->average_probe = (float)total_probe / (float)map->count;
+
+        for (uint32_t i = 1; i < map->section_count; i++) {
+            stats->key_bytes += map->sections[i].len;
+            if (map->sections[i].owned && map->sections[i].len + 1 > VARS_POOL_MAX_CLASS) stats->owned_bytes += map->sections[i].len + 1;
+        }
+        for (const vars_pool_block* block = map->pool.blocks; block; block = block->next) {
+            stats->owned_bytes += sizeof(vars_pool_block) + VARS_POOL_BLOCK_SIZE;
+        }
+    }
+
+    if (usage) {
+        stats->parse_seconds = usage->parse_seconds;
+        stats->reload_seconds = usage->reload_seconds;
+#ifdef VARS_ENABLE_STATS
+        stats->lookups = usage->lookups;
+        stats->misses = usage->misses;
+#endif
+    }
+    return 1;
+}
+
 VARSAPI int vars_free(vars_file file) {
-    if (file.filebuf) free(file.filebuf);
-    if (file.parsed_buf) free(file.parsed_buf);
-    if (file.file_path) free(file.file_path);
+    vars__release_buffer(&file);
+    if (file.file_path) VARS_FREE(file.file_path);
     if (file.map) {
+        vars__release_includes(file.map);
         vars_map_free(file.map);
-        free(file.map);
+        VARS_FREE(file.map);
     }
+    VARS_FREE(file.binary);
+    vars__free_listeners(file.listeners);
+    vars__journal_close(file.journal);
     return 0;
 }
 
-VARSAPI vars_file vars_load(const char* file_path) {
-    vars_file file = vars__load_and_parse_file(file_path);
+static vars_file vars__load(const char* file_path, int storage) {
+    vars_file file = storage == VARS_STORAGE_BINARY ? vars__load_binary_file(file_path)
+                                                    : vars__load_and_parse_file(file_path, storage);
+    size_t journal_size;
+    if (file.map) vars__journal_load(&file, file_path, &journal_size);
     
     // Store file path and modification time for hot reload
     size_t path_len = strlen(file_path);
-    file.file_path = (char*)malloc(path_len + 1);
+    file.file_path = (char*)VARS_MALLOC(path_len + 1);
     if (!file.file_path) {
         fprintf(stderr, "ERROR: vars_load: Memory allocation failed for file path.\n");
         vars_free(file);
@@ -661,4 +4494,432 @@ VARSAPI vars_file vars_load(const char* file_path) {
     return file;
 }
 
+VARSAPI vars_file vars_load(const char* file_path) {
+    return vars__load(file_path, VARS_STORAGE_HEAP);
+}
+
+// Maps the file read-only instead of reading it into memory. Keys and values
+// are views into the mapping, so loading copies nothing and the contents are
+// shared with the page cache. Values written with vars_set_* are copied out.
+VARSAPI vars_file vars_load_mmap(const char* file_path) {
+    return vars__load(file_path, VARS_STORAGE_MMAP);
+}
+
+// Maps a file written by vars_compile(). Lookups go through its perfect hash
+// and pre-parsed values, so nothing is parsed or allocated per key. Compiled
+// files are read-only: vars_set_* and vars_save return 0.
+VARSAPI vars_file vars_load_binary(const char* file_path) {
+    return vars__load(file_path, VARS_STORAGE_BINARY);
+}
+
+// Loads a text or compiled file that is already in memory, e.g. read from an
+// archive. With VARS_MEMORY_BORROW keys and values point into buffer, which
+// must outlive the file. VARS_MEMORY_OWN hands over a buffer from VARS_MALLOC
+// for vars_free() to release, and VARS_MEMORY_COPY copies it first. The file
+// has no path, so vars_hot_load() and vars_save() return 0.
+VARSAPI vars_file vars_load_memory(const char* buffer, size_t len, int flags) {
+    vars_file file = {0};
+    if (!buffer && len) {
+        fprintf(stderr, "ERROR: vars_load_memory: No buffer.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // Compiled tables are read in place, which needs 4 byte alignment.
+    int compiled = len >= 4 && memcmp(buffer, VARS_BINARY_MAGIC, 4) == 0;
+    int misaligned = compiled && ((uintptr_t)buffer & 3) != 0;
+    if (flags == VARS_MEMORY_COPY || misaligned) {
+        file.filebuf = (char*)VARS_MALLOC(len ? len : 1);
+        if (!file.filebuf) vars__out_of_memory();
+        if (len) memcpy(file.filebuf, buffer, len);
+        file.storage = VARS_STORAGE_HEAP;
+        if (flags == VARS_MEMORY_OWN) VARS_FREE((void*)buffer);
+    } else {
+        file.filebuf = (char*)buffer;
+        file.storage = flags == VARS_MEMORY_OWN ? VARS_STORAGE_HEAP : VARS_STORAGE_BORROWED;
+    }
+    file.filebuf_len = len;
+
+    if (compiled) {
+        if (!vars__binary_attach(&file)) {
+            fprintf(stderr, "ERROR: vars_load_memory: Not a valid compiled vars file.\n");
+            exit(EXIT_FAILURE);
+        }
+    } else {
+        vars__parse_buffer(&file);
+    }
+    return file;
+}
+
+// ---------------------------------------------
+// SHARED SNAPSHOTS
+// ---------------------------------------------
+
+// A vars_shared lets many threads read a file while one thread reloads it.
+// Each load is an immutable snapshot. A reload parses the new contents off to
+// the side and publishes them with one atomic pointer swap, so readers never
+// wait and never see a half-built table.
+//
+// Old snapshots are reclaimed with epochs. A reader stores the current epoch
+// in its slot before loading the snapshot pointer and clears it when done. A
+// snapshot retired in epoch E can be freed once no reader slot holds an epoch
+// of E or less, because any reader that announced a later epoch read it after
+// the swap. Readers only ever do a store and two loads; reclaiming happens on
+// the reloading thread.
+
+#ifndef VARS_MAX_READERS
+#define VARS_MAX_READERS 64
+#endif
+
+typedef struct vars_snapshot {
+    vars_file file;
+    uint64_t retired_epoch;
+    struct vars_snapshot* next;
+} vars_snapshot;
+
+#define VARS_CACHE_LINE 64
+#if defined(_MSC_VER) && !defined(__clang__)
+#define VARS_CACHE_ALIGNED __declspec(align(64))
+#else
+#define VARS_CACHE_ALIGNED __attribute__((aligned(64)))
+#endif
+
+// One cache line per reader, so readers don't slow each other down.
+struct VARS_CACHE_ALIGNED vars_reader {
+    uint64_t epoch; // 0 while the reader holds no snapshot.
+    int in_use;
+    vars_shared* shared;
+};
+typedef char vars__reader_fills_one_line[sizeof(struct vars_reader) == VARS_CACHE_LINE ? 1 : -1];
+
+struct vars_shared {
+    void* current; // vars_snapshot*
+    uint64_t epoch;
+    vars_snapshot* retired; // Only touched by the reloading thread.
+    void* allocation; // What VARS_MALLOC returned, before aligning to a cache line.
+    vars_reader readers[VARS_MAX_READERS];
+};
+
+// Frees retired snapshots that no reader can still be looking at.
+static void vars__shared_collect(vars_shared* shared) {
+    uint64_t oldest = UINT64_MAX;
+    for (int i = 0; i < VARS_MAX_READERS; i++) {
+        uint64_t epoch = vars__atomic_load_u64(&shared->readers[i].epoch);
+        if (epoch && epoch < oldest) oldest = epoch;
+    }
+
+    vars_snapshot** link = &shared->retired;
+    while (*link) {
+        vars_snapshot* snapshot = *link;
+        if (snapshot->retired_epoch < oldest) {
+            *link = snapshot->next;
+            vars_free(snapshot->file);
+            VARS_FREE(snapshot);
+        } else {
+            link = &snapshot->next;
+        }
+    }
+}
+
+// Takes ownership of a loaded file and makes it the first snapshot.
+// Returns NULL if memory runs out, in which case the file is left to the caller.
+VARSAPI vars_shared* vars_shared_create(vars_file file) {
+    // VARS_MALLOC only promises alignment for ordinary types, so the readers are aligned by hand.
+    void* allocation = vars__calloc(1, sizeof(vars_shared) + VARS_CACHE_LINE - 1);
+    vars_snapshot* snapshot = (vars_snapshot*)vars__calloc(1, sizeof(vars_snapshot));
+    if (!allocation || !snapshot) {
+        VARS_FREE(allocation);
+        VARS_FREE(snapshot);
+        return NULL;
+    }
+    vars_shared* shared = (vars_shared*)(((uintptr_t)allocation + VARS_CACHE_LINE - 1) & ~(uintptr_t)(VARS_CACHE_LINE - 1));
+    shared->allocation = allocation;
+    snapshot->file = file;
+    // Iterators build the key order on first use, so build it before readers can race on it.
+    if (file.map) vars__order_update(snapshot->file.map);
+    shared->current = snapshot;
+    shared->epoch = 1;
+    for (int i = 0; i < VARS_MAX_READERS; i++) shared->readers[i].shared = shared;
+    return shared;
+}
+
+// Publishes a new snapshot if the file changed on disk, and frees old
+// snapshots that all readers have moved on from. Only one thread may call
+// this at a time. Returns 1 if a new snapshot was published.
+VARSAPI int vars_shared_reload(vars_shared* shared) {
+    if (!shared) return 0;
+    vars_snapshot* current = (vars_snapshot*)shared->current;
+    vars_file* file = &current->file;
+
+    int published = 0;
+    int64_t mod_time = file->file_path ? vars__get_file_mod_time(file->file_path) : -1;
+    int stale = mod_time != file->last_modified || (file->map && vars__includes_stale(file->map));
+    if (mod_time != -1 && stale) {
+        vars_snapshot* snapshot = (vars_snapshot*)vars__calloc(1, sizeof(vars_snapshot));
+        if (!snapshot) return 0;
+        snapshot->file = vars__load(file->file_path, file->binary ? VARS_STORAGE_BINARY : file->storage);
+
+        // Handles move from one snapshot to the next, so generations keep counting up.
+        if (file->map) snapshot->file.map->generation = file->map->generation + 1;
+        if (file->binary) snapshot->file.binary->generation = file->binary->generation + 1;
+        if (snapshot->file.map) vars__order_update(snapshot->file.map);
+
+        vars__atomic_exchange_ptr(&shared->current, snapshot);
+        uint64_t epoch = vars__atomic_load_u64(&shared->epoch);
+        current->retired_epoch = epoch;
+        current->next = shared->retired;
+        shared->retired = current;
+        vars__atomic_store_u64(&shared->epoch, epoch + 1);
+        published = 1;
+    }
+
+    vars__shared_collect(shared);
+    return published;
+}
+
+// Claims a reader slot. Each thread that reads needs its own.
+// Returns NULL when all VARS_MAX_READERS slots are taken.
+VARSAPI vars_reader* vars_shared_reader(vars_shared* shared) {
+    if (!shared) return NULL;
+    for (int i = 0; i < VARS_MAX_READERS; i++) {
+        if (vars__atomic_claim(&shared->readers[i].in_use)) return &shared->readers[i];
+    }
+    return NULL;
+}
+
+VARSAPI void vars_reader_free(vars_reader* reader) {
+    if (!reader) return;
+    vars__atomic_store_u64(&reader->epoch, 0);
+    vars__atomic_release_flag(&reader->in_use);
+}
+
+// Returns the current snapshot, which stays valid until vars_read_end().
+// Use it with the getters only; snapshots must not be set, saved or reloaded.
+VARSAPI vars_file* vars_read_begin(vars_reader* reader) {
+    vars_shared* shared = reader->shared;
+    vars__atomic_store_u64(&reader->epoch, vars__atomic_load_u64(&shared->epoch));
+    vars_snapshot* snapshot = (vars_snapshot*)vars__atomic_load_ptr(&shared->current);
+    return &snapshot->file;
+}
+
+VARSAPI void vars_read_end(vars_reader* reader) {
+    vars__atomic_store_u64(&reader->epoch, 0);
+}
+
+// Frees every snapshot. No reader may be inside vars_read_begin/vars_read_end.
+VARSAPI void vars_shared_free(vars_shared* shared) {
+    if (!shared) return;
+    while (shared->retired) {
+        vars_snapshot* snapshot = shared->retired;
+        shared->retired = snapshot->next;
+        vars_free(snapshot->file);
+        VARS_FREE(snapshot);
+    }
+    vars_snapshot* current = (vars_snapshot*)shared->current;
+    vars_free(current->file);
+    VARS_FREE(current);
+    VARS_FREE(shared->allocation);
+}
+
+
+// ---------------------------------------------
+// LAYERED STACKS
+// ---------------------------------------------
+
+// A stack merges its layers into one more map whose pairs are views of the
+// winning layer's keys and values, so a get is a single probe however many
+// layers there are. Only section names are copied into the merged map. A
+// reloaded layer only revisits its own keys, old and new.
+
+struct vars_stack {
+    vars_file* layers; // layers[0] has the lowest precedence.
+    size_t count;
+    vars_file merged;
+};
+
+// The lookup key of a pair of map, for finding the same key in another map.
+static void vars__pair_ref(const vars_map* map, const vars_kv_pair* pair, vars_key_ref* ref) {
+    const vars_section* section = &map->sections[pair->section];
+    ref->hash = pair->hash;
+    ref->section = section->name;
+    ref->section_len = section->len;
+    ref->key = pair->key;
+    ref->key_len = pair->key_len;
+}
+
+// Points the merged pair for source's key at source, adding it if needed.
+// remap caches merged section indices by the source layer's section index.
+static int vars__stack_put(vars_map* merged, const vars_map* layer, const vars_kv_pair* source, uint32_t* remap) {
+    vars_key_ref ref;
+    vars__pair_ref(layer, source, &ref);
+    vars_kv_pair* pair = vars_map_find_ref(merged, &ref);
+    if (pair) {
+        pair->key = source->key;
+        pair->value = source->value;
+        pair->value_len = source->value_len;
+        pair->typed = source->typed;
+        return 1;
+    }
+
+    if (remap[source->section] == UINT32_MAX) remap[source->section] = vars_map_section(merged, ref.section, ref.section_len, 1);
+    if (remap[source->section] == UINT32_MAX || !vars_map_reserve(merged)) return 0;
+    vars_kv_pair copy = *source;
+    copy.flags = 0;
+    copy.section = remap[source->section];
+    merged->generation++;
+    return vars_map_place(merged, &copy) != NULL;
+}
+
+// Brings the merged entry for one key of layer index, from its old or new
+// contents, up to date. Keys a higher layer overrides stay as they are.
+static int vars__stack_refresh(vars_stack* stack, size_t index, const vars_map* from, const vars_kv_pair* pair, uint32_t** remaps) {
+    vars_key_ref ref;
+    vars__pair_ref(from, pair, &ref);
+    for (size_t i = stack->count; i-- > 0;) {
+        const vars_kv_pair* winner = vars_map_find_ref(stack->layers[i].map, &ref);
+        if (!winner) continue;
+        if (i > index) return 1;
+        return vars__stack_put(stack->merged.map, stack->layers[i].map, winner, remaps[i]);
+    }
+
+    vars_kv_pair* stale = vars_map_find_ref(stack->merged.map, &ref);
+    if (stale) vars_map_erase(stack->merged.map, stale);
+    return 1;
+}
+
+// One section remap per layer for vars__stack_put(), all unset.
+static uint32_t** vars__stack_remaps(vars_stack* stack) {
+    uint32_t** remaps = (uint32_t**)vars__calloc(stack->count, sizeof(uint32_t*));
+    if (!remaps) return NULL;
+    for (size_t i = 0; i < stack->count; i++) {
+        uint32_t section_count = stack->layers[i].map->section_count;
+        remaps[i] = (uint32_t*)VARS_MALLOC(section_count * sizeof(uint32_t));
+        if (!remaps[i]) {
+            while (i-- > 0) VARS_FREE(remaps[i]);
+            VARS_FREE(remaps);
+            return NULL;
+        }
+        memset(remaps[i], 0xFF, section_count * sizeof(uint32_t));
+    }
+    return remaps;
+}
+
+static void vars__stack_free_remaps(vars_stack* stack, uint32_t** remaps) {
+    for (size_t i = 0; i < stack->count; i++) VARS_FREE(remaps[i]);
+    VARS_FREE(remaps);
+}
+
+// Takes ownership of count loaded text files, in order of precedence: keys in
+// layers[count - 1] win over the same keys anywhere below. Returns NULL if
+// memory runs out or a layer is compiled, in which case the files are left to
+// the caller.
+VARSAPI vars_stack* vars_stack_create(vars_file* layers, size_t count) {
+    if (!layers || !count) return NULL;
+    size_t total = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (!layers[i].map) return NULL;
+        total += layers[i].map->count;
+    }
+
+    vars_stack* stack = (vars_stack*)vars__calloc(1, sizeof(vars_stack));
+    vars_map* merged = (vars_map*)VARS_MALLOC(sizeof(vars_map));
+    vars_file* owned = (vars_file*)VARS_MALLOC(count * sizeof(vars_file));
+    if (!stack || !merged || !owned || !vars_map_init(merged, vars_map_capacity_for(total))) {
+        VARS_FREE(stack);
+        VARS_FREE(merged);
+        VARS_FREE(owned);
+        return NULL;
+    }
+    memcpy(owned, layers, count * sizeof(vars_file));
+    stack->layers = owned;
+    stack->count = count;
+    stack->merged.map = merged;
+    stack->merged.storage = VARS_STORAGE_MERGED;
+
+    // From the top down, so each key is written once, by its winner.
+    uint32_t** remaps = vars__stack_remaps(stack);
+    int ok = remaps != NULL;
+    for (size_t i = count; ok && i-- > 0;) {
+        const vars_map* layer = owned[i].map;
+        for (size_t slot = 0; ok && slot < layer->capacity; slot++) {
+            if (!VARS_CTRL_IS_FULL(layer->ctrl[slot])) continue;
+            vars_key_ref ref;
+            vars__pair_ref(layer, &layer->entries[slot], &ref);
+            if (vars_map_find_ref(merged, &ref)) continue;
+            ok = vars__stack_put(merged, layer, &layer->entries[slot], remaps[i]);
+        }
+    }
+    if (remaps) vars__stack_free_remaps(stack, remaps);
+    if (!ok) {
+        vars_map_free(merged);
+        VARS_FREE(merged);
+        VARS_FREE(owned);
+        VARS_FREE(stack);
+        return NULL;
+    }
+    return stack;
+}
+
+// The merged view, for the getters, handles, vars_get_many() and iterators.
+// It is read-only: setters, vars_save() and vars_hot_load() return 0 for it.
+VARSAPI vars_file* vars_stack_file(vars_stack* stack) {
+    return stack ? &stack->merged : NULL;
+}
+
+// Reloads the layers whose files changed on disk and re-merges their keys.
+// Returns 1 if any layer was reloaded. Handles and iterators of the merged
+// file notice when keys were added or removed, like after vars_hot_load().
+VARSAPI int vars_stack_hot_load(vars_stack* stack) {
+    if (!stack) return 0;
+    int reloaded = 0;
+    for (size_t i = 0; i < stack->count; i++) {
+        vars_file* layer = &stack->layers[i];
+        if (!layer->file_path) continue;
+        int64_t mod_time = vars__get_file_mod_time(layer->file_path);
+        if (mod_time == -1) continue;
+        if (mod_time == layer->last_modified && !(layer->map && vars__includes_stale(layer->map))) continue;
+
+        double started = vars__now();
+        vars_file fresh;
+        if (!vars__parse_file(layer->file_path, layer->storage == VARS_STORAGE_MMAP ? VARS_STORAGE_MMAP : VARS_STORAGE_HEAP, &fresh)) continue;
+        size_t journal_size;
+        vars__journal_load(&fresh, layer->file_path, &journal_size);
+
+        vars_file old = *layer;
+        *layer = fresh;
+        layer->file_path = old.file_path;
+        layer->last_modified = mod_time;
+        layer->listeners = old.listeners;
+        layer->journal = old.journal;
+        layer->map->usage = old.map->usage;
+        old.file_path = NULL;
+        old.listeners = NULL;
+        old.journal = NULL;
+
+        // The old keys still point into the old layer, which is freed last.
+        uint32_t** remaps = vars__stack_remaps(stack);
+        if (!remaps) vars__out_of_memory();
+        const vars_map* maps[2] = { old.map, layer->map };
+        for (int m = 0; m < 2; m++) {
+            for (size_t slot = 0; slot < maps[m]->capacity; slot++) {
+                if (!VARS_CTRL_IS_FULL(maps[m]->ctrl[slot])) continue;
+                if (!vars__stack_refresh(stack, i, maps[m], &maps[m]->entries[slot], remaps)) vars__out_of_memory();
+            }
+        }
+        vars__stack_free_remaps(stack, remaps);
+        vars_free(old);
+        layer->map->usage.reload_seconds = vars__now() - started;
+        stack->merged.map->usage.reload_seconds = layer->map->usage.reload_seconds;
+        reloaded = 1;
+    }
+    return reloaded;
+}
+
+VARSAPI void vars_stack_free(vars_stack* stack) {
+    if (!stack) return;
+    vars_free(stack->merged);
+    for (size_t i = 0; i < stack->count; i++) vars_free(stack->layers[i]);
+    VARS_FREE(stack->layers);
+    VARS_FREE(stack);
+}
+
 #endif // VARS_IMPLEMENTATION